@@ -0,0 +1,245 @@
+#include "gmp_arena.hpp"
+#include "tasks.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Submits num_tasks factorials and waits for all of them
+     * @param num_threads Threads in thread pool
+     * @param options Pool start options
+     * @param num_tasks Number of tasks
+     * @param arg Argument of every factorial
+     * @param placement_failures Failed pinnings and memory bindings of workers (output, optional)
+     * @return Wall time in seconds
+     */
+    double run_factorials(size_t num_threads, const TP::StartOptions &options, int num_tasks, int arg,
+                          size_t *placement_failures = nullptr)
+    {
+        TP::ThreadPool pool;
+        std::vector<TP::TaskInfo<mpz_class>> infos;
+        infos.reserve(num_tasks);
+
+        auto begin = Clock::now();
+        pool.start(num_threads, options);
+        for (int i = 0; i < num_tasks; i++)
+        {
+            infos.push_back(pool.add_task(tasks::factorial, arg));
+        }
+        for (auto &info : infos)
+        {
+            info.result();
+        }
+        auto end = Clock::now();
+        pool.stop();
+        if (placement_failures)
+            *placement_failures = pool.num_placement_failures();
+
+        return std::chrono::duration<double>(end - begin).count();
+    }
+
+    /**
+     * @brief Compares large factorial throughput for all affinity policies
+     */
+    void bench_affinity(int num_tasks, int arg)
+    {
+        size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::printf("affinity: %zu threads, %d x factorial(%d), %zu NUMA node(s)\n",
+                    num_threads, num_tasks, arg, TP::CpuTopology::detect().num_nodes());
+
+        struct Case
+        {
+            const char *name;
+            TP::AffinityPolicy affinity;
+            bool bind_memory;
+        };
+        const Case cases[] = {
+            {"none", TP::AffinityPolicy::None, false},
+            {"compact", TP::AffinityPolicy::Compact, false},
+            {"compact+membind", TP::AffinityPolicy::Compact, true},
+            {"scatter", TP::AffinityPolicy::Scatter, false},
+            {"scatter+membind", TP::AffinityPolicy::Scatter, true},
+        };
+
+        for (const auto &c : cases)
+        {
+            TP::StartOptions options;
+            options.affinity = c.affinity;
+            options.bind_memory = c.bind_memory;
+            size_t failures = 0;
+            double seconds = run_factorials(num_threads, options, num_tasks, arg, &failures);
+            std::printf("  %-16s %8.3f s %10.1f tasks/s", c.name, seconds, num_tasks / seconds);
+            if (failures)
+                std::printf("  (%zu placement failures, not pinned)", failures);
+            std::printf("\n");
+        }
+    }
+
+    /**
+     * @brief Measures round-trip latency of tiny tasks for different idle strategies
+     * Spinning needs a spare core for the worker, results on a single CPU are not representative
+     */
+    void bench_idle(int num_tasks)
+    {
+        std::printf("idle: %d sequential x fib(10), %u CPU(s)\n", num_tasks, std::thread::hardware_concurrency());
+
+        struct Case
+        {
+            const char *name;
+            size_t spin_count;
+            size_t yield_count;
+        };
+        const Case cases[] = {
+            {"park", 0, 0},
+            {"yield", 0, 64},
+            {"spin+yield", 4096, 64},
+        };
+
+        for (const auto &c : cases)
+        {
+            TP::StartOptions options;
+            options.idle.spin_count = c.spin_count;
+            options.idle.yield_count = c.yield_count;
+
+            TP::ThreadPool pool;
+            pool.start(1, options);
+            auto begin = Clock::now();
+            for (int i = 0; i < num_tasks; i++)
+            {
+                pool.add_task(tasks::fib, 10).result();
+            }
+            auto end = Clock::now();
+            pool.stop();
+
+            double us = std::chrono::duration<double, std::micro>(end - begin).count() / num_tasks;
+            std::printf("  %-16s %8.2f us/task\n", c.name, us);
+        }
+    }
+
+    /**
+     * @brief Product of first, first + stride, ..., up to last with one mpz_mul_ui per factor (reference)
+     */
+    mpz_class product_per_factor(int first, int last, int stride)
+    {
+        mpz_class acc = 1;
+        for (int i = first; i <= last; i += stride)
+        {
+            acc *= i;
+        }
+        return acc;
+    }
+
+    /**
+     * @brief Compares multiplication by every factor with the word-packed kernel (see tasks::ProductJob)
+     */
+    void bench_product(int num_tasks, int arg)
+    {
+        std::printf("product: %d sequential x factorial(%d) and double_factorial(%d)\n", num_tasks, arg, arg);
+
+        struct Case
+        {
+            const char *name;
+            mpz_class (*func)(int);
+        };
+        const Case cases[] = {
+            {"per-factor !", [](int n)
+             { return product_per_factor(1, n, 1); }},
+            {"packed !", tasks::factorial},
+            {"per-factor !!", [](int n)
+             { return product_per_factor((n % 2 == 0) ? 2 : 1, n, 2); }},
+            {"packed !!", tasks::double_factorial},
+        };
+
+        for (const auto &c : cases)
+        {
+            auto begin = Clock::now();
+            for (int i = 0; i < num_tasks; i++)
+            {
+                c.func(arg);
+            }
+            auto end = Clock::now();
+
+            double ms = std::chrono::duration<double, std::milli>(end - begin).count() / num_tasks;
+            std::printf("  %-16s %8.3f ms/task\n", c.name, ms);
+        }
+    }
+
+    /**
+     * @brief Compares factorial throughput and peak RSS of the default GMP allocator and the thread-local arena
+     * Every case runs in a forked process: the allocator can not be changed back and peak RSS only grows
+     */
+    void bench_alloc(int num_tasks, int arg)
+    {
+        size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::printf("alloc: %zu threads, %d x factorial(%d)\n", num_threads, num_tasks, arg);
+        std::fflush(stdout);
+
+        const char *cases[] = {"malloc", "arena"};
+        for (const char *name : cases)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                if (std::string(name) == "arena")
+                    TP::install_gmp_arena();
+
+                double seconds = run_factorials(num_threads, TP::StartOptions(), num_tasks, arg);
+
+                struct rusage usage;
+                getrusage(RUSAGE_SELF, &usage);
+                std::printf("  %-16s %8.3f s %10.1f tasks/s %10.1f MiB peak RSS\n",
+                            name, seconds, num_tasks / seconds, usage.ru_maxrss / 1024.0);
+                std::fflush(stdout);
+                _exit(0);
+            }
+            if (pid > 0)
+                waitpid(pid, nullptr, 0);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // Usage: qml_threadpool_bench [scenario] [num_tasks] [arg]
+    std::string scenario = (argc > 1) ? argv[1] : "affinity";
+    int num_tasks = (argc > 2) ? std::atoi(argv[2]) : 256;
+    int arg = (argc > 3) ? std::atoi(argv[3]) : 50000;
+
+    if (scenario == "affinity")
+    {
+        bench_affinity(num_tasks, arg);
+        return 0;
+    }
+    if (scenario == "idle")
+    {
+        bench_idle(num_tasks);
+        return 0;
+    }
+    if (scenario == "alloc")
+    {
+        bench_alloc(num_tasks, arg);
+        return 0;
+    }
+    if (scenario == "product")
+    {
+        bench_product(num_tasks, arg);
+        return 0;
+    }
+
+    std::fprintf(stderr, "Unknown scenario: %s\n", scenario.c_str());
+    return 1;
+}
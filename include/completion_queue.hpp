@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace TP
+{
+    /**
+     * @brief Queue of indices of finished tasks, filled by the pool (see TaskOptions::completion
+     * and ThreadPool::set_completion_queue)
+     * Consumers harvest completions in batches instead of polling every TaskInfo,
+     * so the cost is proportional to the number of completed tasks only.
+     *
+     * Removed tasks are reported as well, their futures hold std::future_error (broken promise).
+     * Tasks that finished before the queue was attached are never reported.
+     */
+    class CompletionQueue
+    {
+    public:
+        // Timeout of waiting methods that never expires
+        static constexpr std::chrono::milliseconds kInfinite = std::chrono::milliseconds::max();
+
+        /**
+         * @brief Reports finished task, called by the pool
+         * @param idx Task index
+         */
+        void push(size_t idx);
+
+        /**
+         * @brief Takes completions without waiting
+         * @param max_batch Maximum number of returned indices
+         * @return Indices of completed tasks in order of completion (could be empty)
+         */
+        std::vector<size_t> poll_completed(size_t max_batch = SIZE_MAX);
+
+        /**
+         * @brief Waits for at least one completion and takes completions
+         * @param timeout Maximum waiting time (kInfinite - wait forever)
+         * @param max_batch Maximum number of returned indices
+         * @return Indices of completed tasks in order of completion, empty on timeout
+         */
+        std::vector<size_t> wait_completed(std::chrono::milliseconds timeout, size_t max_batch = SIZE_MAX);
+
+        /**
+         * @brief Waits for completion of all given tasks, their completions are taken from the queue
+         * Completions of other tasks are kept in the queue
+         * @param idxs Indices of tasks, on return contains indices of tasks that are not completed yet
+         * @param timeout Maximum waiting time (kInfinite - wait forever)
+         * @return All tasks completed (true) or timeout (false)
+         */
+        bool wait_all(std::unordered_set<size_t> &idxs, std::chrono::milliseconds timeout = kInfinite);
+
+        /**
+         * @brief Waits for completion of any of given tasks, its completion is taken from the queue
+         * Completions of other tasks are kept in the queue
+         * @param idxs Indices of tasks
+         * @param idx Index of the completed task (output)
+         * @param timeout Maximum waiting time (kInfinite - wait forever)
+         * @return Some task completed (true) or timeout (false)
+         */
+        bool wait_any(const std::unordered_set<size_t> &idxs, size_t &idx, std::chrono::milliseconds timeout = kInfinite);
+
+        /**
+         * @brief Returns number of completions that are not taken yet
+         */
+        size_t size() const;
+
+    private:
+        /**
+         * @brief Completion with its sequence number, entries are ordered by seq
+         * Waiters remember the last checked seq, so they check only new entries on every wakeup
+         */
+        struct Entry
+        {
+            uint64_t seq;
+            size_t idx;
+        };
+
+        /**
+         * @brief Takes entries of given tasks pushed after seq, m_mtx should be locked
+         * @param idxs Indices of tasks
+         * @param seq Last checked seq, updated
+         * @param max_count Maximum number of taken entries
+         * @param taken Indices of taken entries (output)
+         */
+        void take_matching(const std::unordered_set<size_t> &idxs, uint64_t &seq, size_t max_count, std::vector<size_t> &taken);
+
+        /**
+         * @brief Waits till pred returns true or timeout, m_mtx should be locked
+         * @return Result of pred
+         */
+        template <typename Pred>
+        bool wait(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds timeout, Pred pred);
+
+        /**
+         * @brief Moves batch from the front of the queue, m_mtx should be locked
+         */
+        std::vector<size_t> take(size_t max_batch);
+
+        mutable std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::deque<Entry> m_completed;
+        uint64_t m_last_seq = 0;
+    };
+}
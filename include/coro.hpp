@@ -0,0 +1,477 @@
+#pragma once
+
+// C++20 coroutine interface for ThreadPool
+// Opt-in: configure with -DQML_THREADPOOL_COROUTINES=ON
+
+#if !defined(__cpp_impl_coroutine)
+#error "coro.hpp requires C++20 coroutines (configure with -DQML_THREADPOOL_COROUTINES=ON)"
+#endif
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace TP
+{
+    /**
+     * @brief Allocator for coroutine frames
+     * Frames are kept in thread-local free lists by size class (64 byte granularity)
+     * Only the allocating thread caches a frame, frames freed by other threads (e.g. a coroutine
+     * resumed on another worker) go back to the global allocator. Every thread caches at most
+     * kMaxCachedBytes, so the retained memory is bounded by kMaxCachedBytes per thread.
+     * Big frames go directly to the global allocator
+     */
+    class FrameAllocator
+    {
+    public:
+        static void *allocate(std::size_t size)
+        {
+            std::size_t size_class = (size + kGranularity - 1) / kGranularity;
+            if (size_class >= kNumClasses)
+                return user_ptr(new_block(size, nullptr));
+
+            FreeLists &lists = free_lists();
+            auto &list = lists[size_class];
+            if (!list.empty())
+            {
+                Header *header = list.back();
+                list.pop_back();
+                lists.cached_bytes -= size_class * kGranularity;
+                return user_ptr(header);
+            }
+            return user_ptr(new_block(size_class * kGranularity, &lists));
+        }
+
+        static void deallocate(void *ptr, std::size_t size)
+        {
+            Header *header = static_cast<Header *>(ptr) - 1;
+            std::size_t size_class = (size + kGranularity - 1) / kGranularity;
+            FreeLists &lists = free_lists();
+            std::size_t class_bytes = size_class * kGranularity;
+            if (header->owner != &lists || lists.cached_bytes + class_bytes > kMaxCachedBytes)
+            {
+                ::operator delete(header);
+                return;
+            }
+            lists[size_class].push_back(header);
+            lists.cached_bytes += class_bytes;
+        }
+
+    private:
+        static constexpr std::size_t kGranularity = 64;
+        static constexpr std::size_t kNumClasses = 32;             // frames up to 2 KB are cached
+        static constexpr std::size_t kMaxCachedBytes = 256 * 1024; // per thread
+
+        struct FreeLists;
+
+        // Prefix of every frame, keeps the frame 16 bytes aligned
+        struct alignas(16) Header
+        {
+            FreeLists *owner; // nullptr - big frame, never cached
+        };
+
+        // Free lists of the calling thread, memory is released when the thread exits
+        struct FreeLists
+        {
+            std::vector<Header *> lists[kNumClasses];
+            std::size_t cached_bytes = 0;
+
+            std::vector<Header *> &operator[](std::size_t size_class) { return lists[size_class]; }
+
+            ~FreeLists()
+            {
+                for (auto &list : lists)
+                {
+                    for (Header *header : list)
+                    {
+                        ::operator delete(header);
+                    }
+                }
+            }
+        };
+
+        static Header *new_block(std::size_t size, FreeLists *owner)
+        {
+            Header *header = static_cast<Header *>(::operator new(sizeof(Header) + size));
+            header->owner = owner;
+            return header;
+        }
+
+        static void *user_ptr(Header *header) { return header + 1; }
+
+        static FreeLists &free_lists()
+        {
+            thread_local FreeLists lists;
+            return lists;
+        }
+    };
+
+    /**
+     * @brief Base of all promise types, routes frame allocations to FrameAllocator
+     */
+    struct PooledPromise
+    {
+        static void *operator new(std::size_t size) { return FrameAllocator::allocate(size); }
+        static void operator delete(void *ptr, std::size_t size) { FrameAllocator::deallocate(ptr, size); }
+    };
+
+    template <typename T>
+    class Task;
+
+    namespace detail
+    {
+        /**
+         * @brief Storage for result of the coroutine (value or exception)
+         */
+        template <typename T>
+        struct TaskResult
+        {
+            std::optional<T> value;
+            std::exception_ptr error;
+
+            template <typename U>
+            void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+            T get()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct TaskResult<void>
+        {
+            std::exception_ptr error;
+
+            void return_void() {}
+
+            void get()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        };
+
+        /**
+         * @brief Fire-and-forget coroutine, destroys itself on completion
+         */
+        struct Detached
+        {
+            struct promise_type : PooledPromise
+            {
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+    }
+
+    /**
+     * @brief Lazy coroutine task
+     * Starts when awaited and resumes the awaiting coroutine when finished (symmetric transfer)
+     */
+    template <typename T = void>
+    class Task
+    {
+    public:
+        struct promise_type : PooledPromise, detail::TaskResult<T>
+        {
+            std::coroutine_handle<> continuation;
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    auto continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception() { this->error = std::current_exception(); }
+        };
+
+        Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_handle)
+                    m_handle.destroy();
+                m_handle = std::exchange(other.m_handle, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (m_handle)
+                m_handle.destroy();
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+                T await_resume() { return handle.promise().get(); }
+            };
+            return Awaiter{m_handle};
+        }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+        std::coroutine_handle<promise_type> m_handle;
+    };
+
+    /**
+     * @brief Awaitable for task of the pool, resumes the coroutine on a worker when the task is completed
+     * The coroutine does not hold any thread while waiting (see ThreadPool::post)
+     */
+    template <typename T>
+    struct CompletionAwaiter
+    {
+        ThreadPool &pool;
+        const TaskInfo<T> &info;
+
+        bool await_ready() const { return info.status() == TaskStatus::Completed; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            pool.post([handle]
+                      { handle.resume(); },
+                      {&info});
+        }
+        T await_resume() const { return info.future().get(); }
+    };
+
+    /**
+     * @brief Awaits task of the pool: co_await TP::completion(pool, info)
+     * @param pool Pool the task belongs to
+     * @param info Task (should outlive the awaiting)
+     * @return Awaitable object
+     */
+    template <typename T>
+    CompletionAwaiter<T> completion(ThreadPool &pool, const TaskInfo<T> &info)
+    {
+        return CompletionAwaiter<T>{pool, info};
+    }
+
+    namespace detail
+    {
+        // Shared state of when_all
+        template <typename T>
+        struct WhenAllState
+        {
+            std::vector<std::optional<T>> results;
+            std::exception_ptr error;
+            std::atomic<bool> failed = {false};
+            std::atomic<size_t> remaining;
+            std::coroutine_handle<> continuation;
+
+            explicit WhenAllState(size_t n) : results(n), remaining(n + 1) {}
+
+            // Returns true for the last finished participant (including the awaiting coroutine)
+            bool arrive() { return remaining.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+        };
+
+        template <typename T>
+        Detached run_when_all(std::shared_ptr<WhenAllState<T>> state, size_t idx, Task<T> task)
+        {
+            try
+            {
+                state->results[idx].emplace(co_await std::move(task));
+            }
+            catch (...)
+            {
+                // Only the first failed task publishes its exception
+                if (!state->failed.exchange(true, std::memory_order_acq_rel))
+                    state->error = std::current_exception();
+            }
+            if (state->arrive())
+                state->continuation.resume();
+        }
+
+        // Shared state of when_any
+        template <typename T>
+        struct WhenAnyState
+        {
+            std::optional<std::pair<size_t, T>> result;
+            std::exception_ptr error;
+            std::atomic<bool> done = {false};
+            std::atomic<bool> suspended = {false};
+            std::coroutine_handle<> continuation;
+        };
+
+        template <typename T>
+        Detached run_when_any(std::shared_ptr<WhenAnyState<T>> state, size_t idx, Task<T> task)
+        {
+            std::exception_ptr error;
+            std::optional<T> value;
+            try
+            {
+                value.emplace(co_await std::move(task));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // Only the first finished task publishes its result
+            if (state->done.exchange(true, std::memory_order_acq_rel))
+                co_return;
+            if (error)
+                state->error = error;
+            else
+                state->result.emplace(idx, std::move(*value));
+
+            // Resume awaiting coroutine if it has been suspended already
+            if (state->suspended.exchange(true, std::memory_order_acq_rel))
+                state->continuation.resume();
+        }
+    }
+
+    /**
+     * @brief Runs all tasks concurrently and waits for all of them
+     * Tasks should move themselves to the pool (co_await pool.schedule()) to run in parallel
+     * @param tasks Tasks to run
+     * @return Results in the order of tasks (the first exception is rethrown)
+     */
+    template <typename T>
+    Task<std::vector<T>> when_all(std::vector<Task<T>> tasks)
+    {
+        static_assert(!std::is_void<T>::value, "when_all requires tasks with results");
+        auto state = std::make_shared<detail::WhenAllState<T>>(tasks.size());
+
+        // Awaiter keeps plain pointers, state is owned by this frame
+        struct Awaiter
+        {
+            std::shared_ptr<detail::WhenAllState<T>> *state_ptr;
+            std::vector<Task<T>> *tasks;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                auto &state = *state_ptr;
+                state->continuation = handle;
+                for (size_t i = 0; i < tasks->size(); i++)
+                {
+                    detail::run_when_all(state, i, std::move((*tasks)[i]));
+                }
+                // Suspend unless all tasks have finished synchronously
+                return !state->arrive();
+            }
+            void await_resume() const noexcept {}
+        };
+        co_await Awaiter{&state, &tasks};
+
+        if (state->error)
+            std::rethrow_exception(state->error);
+
+        std::vector<T> results;
+        results.reserve(state->results.size());
+        for (auto &result : state->results)
+        {
+            results.push_back(std::move(*result));
+        }
+        co_return results;
+    }
+
+    /**
+     * @brief Runs all tasks concurrently and waits for the first finished one
+     * Remaining tasks keep running, their results are discarded
+     * @param tasks Tasks to run (should not be empty)
+     * @return Index and result of the first finished task
+     */
+    template <typename T>
+    Task<std::pair<size_t, T>> when_any(std::vector<Task<T>> tasks)
+    {
+        static_assert(!std::is_void<T>::value, "when_any requires tasks with results");
+        auto state = std::make_shared<detail::WhenAnyState<T>>();
+
+        // Awaiter keeps plain pointers, state is owned by this frame
+        struct Awaiter
+        {
+            std::shared_ptr<detail::WhenAnyState<T>> *state_ptr;
+            std::vector<Task<T>> *tasks;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                auto &state = *state_ptr;
+                state->continuation = handle;
+                for (size_t i = 0; i < tasks->size(); i++)
+                {
+                    detail::run_when_any(state, i, std::move((*tasks)[i]));
+                }
+                // Suspend unless the first task has finished synchronously
+                return !state->suspended.exchange(true, std::memory_order_acq_rel);
+            }
+            void await_resume() const noexcept {}
+        };
+        co_await Awaiter{&state, &tasks};
+
+        if (state->error)
+            std::rethrow_exception(state->error);
+        co_return std::move(*state->result);
+    }
+
+    /**
+     * @brief Blocks the calling thread until the task is finished
+     * Should not be called from workers of the pool
+     * @param task Task to run
+     * @return Result of the task
+     */
+    template <typename T>
+    T sync_wait(Task<T> task)
+    {
+        detail::TaskResult<T> result;
+        std::promise<void> done;
+
+        [](Task<T> task, detail::TaskResult<T> &result, std::promise<void> &done) -> detail::Detached
+        {
+            try
+            {
+                if constexpr (std::is_void<T>::value)
+                    co_await std::move(task);
+                else
+                    result.return_value(co_await std::move(task));
+            }
+            catch (...)
+            {
+                result.error = std::current_exception();
+            }
+            done.set_value();
+        }(std::move(task), result, done);
+
+        done.get_future().wait();
+        return result.get();
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace TP
+{
+    /**
+     * @brief Placement of worker threads on CPU cores
+     */
+    enum class AffinityPolicy
+    {
+        None,    // Threads are not pinned, the OS migrates them freely
+        Compact, // Fill all cores of one NUMA node before moving to the next one
+        Scatter  // Spread threads round-robin across NUMA nodes
+    };
+
+    /**
+     * @brief CPU and NUMA layout of the host (Linux sysfs based)
+     */
+    class CpuTopology
+    {
+    public:
+        /**
+         * @brief Reads topology of the current host
+         * Only CPUs of the affinity mask of the process (sched_getaffinity) are included
+         * Falls back to a single node with all allowed online CPUs if sysfs is not available
+         * @return Detected topology
+         */
+        static CpuTopology detect();
+
+        /**
+         * @brief Computes CPU for every worker thread
+         * @param num_threads Number of worker threads
+         * @param policy Placement policy
+         * @return CPU index per thread (-1 if thread should not be pinned)
+         */
+        std::vector<int> placement(size_t num_threads, AffinityPolicy policy) const;
+
+        /**
+         * @brief Returns NUMA node of the given CPU
+         * @param cpu CPU index
+         * @return Node index or -1 if CPU is unknown
+         */
+        int node_of(int cpu) const;
+
+        /**
+         * @brief Getter for number of NUMA nodes
+         * @return Number of nodes
+         */
+        size_t num_nodes() const { return m_nodes.size(); }
+
+    private:
+        // System indices of NUMA nodes
+        std::vector<int> m_node_ids;
+
+        // CPUs of every NUMA node (same order as m_node_ids)
+        std::vector<std::vector<int>> m_nodes;
+    };
+
+    /**
+     * @brief Pins calling thread to a single CPU
+     * @param cpu CPU index
+     * @return Success (true) or failure (false)
+     */
+    bool pin_current_thread(int cpu);
+
+    /**
+     * @brief Makes memory of calling thread to be allocated on the given NUMA node (preferred policy)
+     * @param node NUMA node index
+     * @return Success (true) or failure (false)
+     */
+    bool bind_current_thread_memory(int node);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace TP
+{
+    /**
+     * @brief Installs thread-local size-class allocator for GMP (mp_set_memory_functions)
+     * Every thread allocates limbs from its own arena without locking, blocks freed by other threads
+     * are returned to the owner arena through a lock-free list. Arena of an exited thread keeps its blocks
+     * (results could outlive the worker) and is adopted by the next new thread.
+     * Only blocks up to 4 KiB are pooled (arena chunks are never returned to the system),
+     * larger blocks are allocated with malloc directly and are returned by free.
+     *
+     * Should be called before any GMP number is created (e.g. at the beginning of main)
+     * @return Success (true) or failure (false, already installed)
+     */
+    bool install_gmp_arena();
+
+    /**
+     * @brief Checks if the arena allocator is installed
+     * @return Installed (true) or not (false)
+     */
+    bool gmp_arena_installed();
+
+    /**
+     * @brief Returns number of arenas created so far (one per concurrently alive thread that used GMP)
+     */
+    size_t gmp_arena_count();
+}
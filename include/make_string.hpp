@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <exception>
 #include <future>
 #include <gmpxx.h>
 
@@ -38,7 +39,17 @@ namespace TP
     make_string(std::shared_future<T> &future)
     {
         if (future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
-            return make_string(future.get());
+        {
+            // Failed task (e.g. crashed worker process) shows the error instead of the result
+            try
+            {
+                return make_string(future.get());
+            }
+            catch (const std::exception &e)
+            {
+                return std::string("Error: ") + e.what();
+            }
+        }
         return "";
     }
 
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+
+#include <sys/types.h>
+
+namespace TP
+{
+    /**
+     * @brief Function that can be executed in a worker process
+     */
+    typedef mpz_class (*RemoteFunction)(int arg);
+
+    /**
+     * @brief Error of the task executed in a worker process (worker crashed or function failed)
+     */
+    class RemoteError : public std::runtime_error
+    {
+    public:
+        explicit RemoteError(const std::string &what) : std::runtime_error(what) {}
+    };
+
+    /**
+     * @brief Options of worker processes
+     */
+    struct ProcessOptions
+    {
+        // Address space limit of every worker process in bytes (0 - unlimited)
+        // Runaway task kills only its worker, which is respawned
+        size_t memory_limit = 0;
+    };
+
+    /**
+     * @brief Set of local worker processes, that execute registered functions
+     * Every worker is the same executable started with --tp-worker, connected with a Unix domain socket
+     * Results are transferred as raw limbs (64 bit words, least significant first, see SnapshotRecord)
+     * Crashed workers are respawned, the task that was running fails with RemoteError
+     *
+     * Usage with ThreadPool: pool threads call call() from ordinary tasks, so every process has its own heap
+     */
+    class ProcessBackend
+    {
+    public:
+        ProcessBackend() = default;
+        ~ProcessBackend();
+
+        ProcessBackend(const ProcessBackend &) = delete;
+        ProcessBackend &operator=(const ProcessBackend &) = delete;
+
+        /**
+         * @brief Registers function for worker processes
+         * Should be called in the same order in every process, before is_worker (e.g. at the beginning of main)
+         * @param name Name of the function
+         * @param func Function
+         * @return Function index for call()
+         */
+        static uint32_t register_function(const std::string &name, RemoteFunction func);
+
+        /**
+         * @brief Finds registered function by name
+         * @param name Name of the function
+         * @param id Found function index
+         * @return Found (true) or not (false)
+         */
+        static bool find_function(const std::string &name, uint32_t &id);
+
+        /**
+         * @brief Checks if the process has been started as a worker
+         * @param argc Number of command line arguments
+         * @param argv Command line arguments
+         * @return Worker (true) or not (false)
+         */
+        static bool is_worker(int argc, char *argv[]);
+
+        /**
+         * @brief Serves requests of the parent process until it closes the socket
+         * @param argc Number of command line arguments
+         * @param argv Command line arguments
+         * @return Exit code of the worker process
+         */
+        static int worker_main(int argc, char *argv[]);
+
+        /**
+         * @brief Spawns worker processes
+         * @param num_processes Number of worker processes
+         * @param options Worker options (see ProcessOptions)
+         * @return Success (true) or failure (false)
+         */
+        bool start(size_t num_processes, const ProcessOptions &options = ProcessOptions());
+
+        /**
+         * @brief Stops worker processes, waits for running calls to finish
+         * @return Success (true) or failure (false)
+         */
+        bool stop();
+
+        /**
+         * @brief Executes registered function in one of the idle workers, blocks until result is ready
+         * Throws RemoteError if the worker crashed, the function failed or the backend is stopped
+         * @param id Function index (see register_function)
+         * @param arg Argument of the function
+         * @return Result of the function
+         */
+        mpz_class call(uint32_t id, int arg);
+
+        /**
+         * @brief Returns number of worker processes respawned after crash
+         */
+        size_t num_respawned() const;
+
+    private:
+        /**
+         * @brief Worker process and parent end of its socket
+         */
+        struct Worker
+        {
+            pid_t pid = -1;
+            int fd = -1;
+        };
+
+        /**
+         * @brief Starts worker process
+         * @param worker Worker to be filled
+         * @return Success (true) or failure (false)
+         */
+        bool spawn(Worker &worker);
+
+        /**
+         * @brief Closes the socket and reaps worker process
+         * @param worker Worker to be terminated
+         * @param force Kill the process instead of waiting for its exit
+         */
+        static void terminate(Worker &worker, bool force);
+
+        /**
+         * @brief Sends request and receives result
+         * @param worker Worker
+         * @param id Function index
+         * @param arg Argument of the function
+         * @param result Result of the function
+         * @param error Message of the failed function
+         * @return Worker is alive (true) or crashed (false)
+         */
+        static bool transact(Worker &worker, uint32_t id, int arg, mpz_class &result, std::string &error);
+
+        ProcessOptions m_options;
+
+        // Workers that are not executing a call at the moment
+        mutable std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::vector<Worker> m_idle;
+        size_t m_num_workers = 0; // total number of workers, including busy ones
+        size_t m_num_respawned = 0;
+        bool m_active = false;
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <map>
+
+namespace TP
+{
+    /**
+     * @brief Set of task indices stored as disjoint intervals [begin, end)
+     * Task indices are monotonic, so selections are mostly long runs: select all or a range of rows
+     * is a single interval regardless of the number of tasks
+     */
+    class SelectionSet
+    {
+    public:
+        /**
+         * @brief Forward iterator over indices in ascending order
+         */
+        class const_iterator
+        {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef size_t value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const size_t *pointer;
+            typedef const size_t &reference;
+
+            const_iterator() = default;
+            const_iterator(std::map<size_t, size_t>::const_iterator it,
+                           std::map<size_t, size_t>::const_iterator end) : m_it(it), m_end(end),
+                                                                           m_idx(it != end ? it->first : 0) {}
+
+            reference operator*() const { return m_idx; }
+
+            const_iterator &operator++()
+            {
+                if (++m_idx == m_it->second)
+                {
+                    ++m_it;
+                    m_idx = (m_it != m_end) ? m_it->first : 0;
+                }
+                return *this;
+            }
+
+            const_iterator operator++(int)
+            {
+                const_iterator prev = *this;
+                ++*this;
+                return prev;
+            }
+
+            bool operator==(const const_iterator &other) const { return m_it == other.m_it && m_idx == other.m_idx; }
+            bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+        private:
+            std::map<size_t, size_t>::const_iterator m_it;
+            std::map<size_t, size_t>::const_iterator m_end;
+            size_t m_idx = 0;
+        };
+
+        /**
+         * @brief Adds index
+         * @param idx Task index
+         */
+        void insert(size_t idx) { insert_range(idx, idx + 1); }
+
+        /**
+         * @brief Adds all indices from range [first, last), merges adjacent intervals
+         * @param first First index
+         * @param last Index after the last one
+         */
+        void insert_range(size_t first, size_t last);
+
+        /**
+         * @brief Removes index
+         * @param idx Task index
+         * @return Number of removed indices (0 or 1)
+         */
+        size_t erase(size_t idx);
+
+        /**
+         * @brief Removes all indices from range [first, last)
+         * @param first First index
+         * @param last Index after the last one
+         */
+        void erase_range(size_t first, size_t last);
+
+        /**
+         * @brief Removes all indices
+         */
+        void clear()
+        {
+            m_intervals.clear();
+            m_size = 0;
+        }
+
+        /**
+         * @brief Checks if the index is in the set
+         * @param idx Task index
+         * @return 1 if the index is in the set, 0 otherwise
+         */
+        size_t count(size_t idx) const;
+
+        /**
+         * @brief Getters for number of indices and intervals
+         */
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        const std::map<size_t, size_t> &intervals() const { return m_intervals; }
+
+        const_iterator begin() const { return const_iterator(m_intervals.begin(), m_intervals.end()); }
+        const_iterator end() const { return const_iterator(m_intervals.end(), m_intervals.end()); }
+
+    private:
+        // Disjoint, not adjacent intervals (begin -> end)
+        std::map<size_t, size_t> m_intervals;
+
+        // Total number of indices
+        size_t m_size = 0;
+    };
+}
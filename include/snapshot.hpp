@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+
+namespace TP
+{
+    /**
+     * @brief Fixed size description of one task in the snapshot file
+     * File layout: SnapshotHeader, SnapshotRecord[num_records], result limbs (64 bit words)
+     */
+    struct SnapshotRecord
+    {
+        uint64_t id;            // task index at the moment of the snapshot
+        uint64_t result_offset; // offset of result limbs in words from the beginning of data area
+        uint64_t result_size;   // number of result limbs (0 if there is no result)
+        uint32_t type;          // task type (owner specific, e.g. TaskModel::TaskTypes)
+        int32_t arg;            // task argument
+        uint8_t status;         // TaskStatus
+        uint8_t negative;       // sign of the result
+        uint8_t reserved[6];
+    };
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint64_t num_records;
+        uint64_t data_size; // size of data area in words
+    };
+
+    /**
+     * @brief Exports magnitude of the value as 64 bit limbs (least significant first), the sign is dropped
+     * Format of results in snapshots and in responses of worker processes
+     * @param value Value to export
+     * @return Limbs (empty for zero)
+     */
+    std::vector<uint64_t> export_limbs(const mpz_class &value);
+
+    /**
+     * @brief Streams snapshot into the file
+     * Results are written as they are added, the header and records are written by finish()
+     * The file is written to a temporary path and renamed, so an existing snapshot is replaced atomically
+     */
+    class SnapshotWriter
+    {
+    public:
+        /**
+         * @brief Opens temporary file for the snapshot
+         * @param path Path of the snapshot file
+         * @param num_records Exact number of records that will be added
+         */
+        SnapshotWriter(const std::string &path, size_t num_records);
+        ~SnapshotWriter();
+
+        SnapshotWriter(const SnapshotWriter &) = delete;
+        SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+        /**
+         * @brief Adds task without result or with result as mpz
+         * @param record Task description (result fields are filled by the writer)
+         * @param result Result of the task or nullptr
+         */
+        void add(SnapshotRecord record, const mpz_class *result);
+
+        /**
+         * @brief Adds task with result as raw limbs (e.g. copied from another snapshot)
+         * @param record Task description (result fields are filled by the writer)
+         * @param limbs Pointer to limbs (least significant first)
+         * @param size Number of limbs
+         * @param negative Sign of the result
+         */
+        void add_raw(SnapshotRecord record, const uint64_t *limbs, size_t size, bool negative);
+
+        /**
+         * @brief Writes header and records and replaces the snapshot file
+         * The file and its directory are synced to the disk (fsync), so the snapshot survives a crash
+         * @return Success (true) or failure (false)
+         */
+        bool finish();
+
+    private:
+        std::string m_path;
+        std::string m_tmp_path;
+        FILE *m_file = nullptr;
+        bool m_ok = false;
+        size_t m_num_records;
+        uint64_t m_data_size = 0;
+        std::vector<SnapshotRecord> m_records;
+    };
+
+    /**
+     * @brief Read-only memory mapped snapshot
+     * Results are materialized lazily, only when requested
+     */
+    class Snapshot
+    {
+    public:
+        /**
+         * @brief Maps snapshot file into memory
+         * @param path Path of the snapshot file
+         * @return Snapshot or nullptr if the file is missing or malformed
+         */
+        static std::shared_ptr<Snapshot> open(const std::string &path);
+        ~Snapshot();
+
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+
+        /**
+         * @brief Returns number of records
+         */
+        size_t size() const { return m_header->num_records; }
+
+        /**
+         * @brief Returns record by position
+         */
+        const SnapshotRecord &record(size_t i) const { return m_records[i]; }
+
+        /**
+         * @brief Returns pointer to result limbs of the record
+         */
+        const uint64_t *limbs(size_t i) const { return m_data + m_records[i].result_offset; }
+
+        /**
+         * @brief Materializes result of the record
+         */
+        mpz_class result(size_t i) const;
+
+    private:
+        Snapshot() = default;
+
+        void *m_map = nullptr;
+        size_t m_map_size = 0;
+        const SnapshotHeader *m_header = nullptr;
+        const SnapshotRecord *m_records = nullptr;
+        const uint64_t *m_data = nullptr;
+    };
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "task_model.hpp"
+
+#include <vector>
+
+#include <QAbstractListModel>
+#include <QPointer>
+
+/**
+ * @brief Filtered and sorted view of TaskModel for TaskList.qml
+ * Keeps a mapping of its rows to rows of the source model sorted by (sort key, source row),
+ * the mapping is updated incrementally: appended tasks are inserted by binary search and a task
+ * is inserted or removed when its status changes, the whole mapping is rebuilt only when the filter
+ * or the source model is reset.
+ * Without filters and sorted by id the view is an identity and keeps no mapping at all.
+ */
+class TaskFilterModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(TaskModel *sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+    Q_PROPERTY(int statusFilter READ statusFilter WRITE setStatusFilter NOTIFY filterChanged)
+    Q_PROPERTY(int typeFilter READ typeFilter WRITE setTypeFilter NOTIFY filterChanged)
+    Q_PROPERTY(SortKey sortKey READ sortKey WRITE setSortKey NOTIFY filterChanged)
+
+public:
+    /**
+     * @brief Enum of all available sort keys, ties are ordered by id
+     */
+    enum class SortKey
+    {
+        Id,
+        Type,
+        Arg
+    };
+    Q_ENUM(SortKey);
+
+    /**
+     * @brief Constructor
+     */
+    explicit TaskFilterModel(QObject *parent = nullptr);
+
+    // Model basic functionality (forwarded to the source model)
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    bool setData(const QModelIndex &index, const QVariant &v, int role) override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    /**
+     * @brief Getters and setters for properties
+     * Filters are values of TP::TaskStatus and TaskModel::TaskTypes, -1 - any
+     */
+    TaskModel *sourceModel() const { return m_source; }
+    void setSourceModel(TaskModel *source);
+    int statusFilter() const { return m_status_filter; }
+    void setStatusFilter(int status);
+    int typeFilter() const { return m_type_filter; }
+    void setTypeFilter(int type);
+    SortKey sortKey() const { return m_sort_key; }
+    void setSortKey(SortKey key);
+
+    /**
+     * @brief Returns row of the source model
+     * @param row_idx Row of this model
+     * @return Row of the source model or -1 if row_idx is not valid
+     */
+    int sourceRow(int row_idx) const;
+
+public slots:
+    /**
+     * @brief Selects or deselects all tasks of the source model (including filtered out ones)
+     * @param select Select (true) or deselect(false)
+     */
+    void selectTasksAll(bool select);
+
+signals:
+    void sourceModelChanged();
+    void filterChanged();
+
+private:
+    /**
+     * @brief Checks if the view is an identity of the source model (no filters, sorted by id)
+     */
+    bool isIdentity() const;
+
+    /**
+     * @brief Checks if the source row passes filters
+     */
+    bool accepts(int src_row) const;
+
+    /**
+     * @brief Order of source rows in this model
+     */
+    bool lessThan(int src_a, int src_b) const;
+
+    /**
+     * @brief Returns position of the source row in m_rows (where it is or should be inserted)
+     */
+    std::vector<int>::iterator lowerBound(int src_row);
+
+    /**
+     * @brief Calls func(begin, end) for every contiguous range [begin, end) of sorted positions
+     */
+    template <typename Func>
+    static void forEachRange(const std::vector<int> &positions, Func func);
+
+    /**
+     * @brief Removes rows at sorted positions from m_rows in one pass, does not emit any signals
+     */
+    void removeRows(const std::vector<int> &positions);
+
+    /**
+     * @brief Rebuilds m_rows from scratch, does not emit any signals
+     */
+    void rebuild();
+
+    /**
+     * @brief Resets this model with new filters
+     */
+    void reset();
+
+    // Handlers of source model signals
+    void onRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void onRowsInserted(const QModelIndex &parent, int first, int last);
+    void onDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right, const QVector<int> &roles);
+    void onModelAboutToBeReset();
+    void onModelReset();
+
+    // Model with tasks
+    QPointer<TaskModel> m_source;
+
+    // Filters and sort key
+    int m_status_filter = -1;
+    int m_type_filter = -1;
+    SortKey m_sort_key = SortKey::Id;
+
+    // Rows of the source model in order of this model (empty for identity)
+    std::vector<int> m_rows;
+    bool m_identity = true;
+};
@@ -33,6 +33,12 @@ namespace TP
          */
         virtual TaskStatus status() const = 0;
 
+        /**
+         * @brief Checks if the task has been accepted by the pool
+         * @return Valid (true) or rejected (false)
+         */
+        virtual bool valid() const = 0;
+
         /**
          * @brief Instantly returns result of the task
          * If the task is not completed or void - returns an empty string
@@ -105,6 +111,18 @@ namespace TP
             return m_ret_future.get();
         }
 
+        /**
+         * @brief Checks if the task has been accepted by the pool
+         * @return Valid (true) or rejected (false)
+         */
+        bool valid() const { return m_ret_future.valid(); }
+
+        /**
+         * @brief Getter for future with the result of the task
+         * @return Const reference to m_ret_future
+         */
+        const std::shared_future<T> &future() const { return m_ret_future; }
+
         /**
          * @brief Instantly returns result of the task
          * If the task is not completed or void - returns an empty string
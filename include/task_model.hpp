@@ -2,13 +2,18 @@
 
 #include "tasks.hpp"
 #include "thread_pool.hpp"
+#include "snapshot.hpp"
+#include "process_backend.hpp"
+#include "selection_set.hpp"
+#include "task_table.hpp"
 
+#include <atomic>
 #include <memory>
 #include <random>
-#include <unordered_set>
-#include <unordered_map>
+#include <vector>
 
 #include <QAbstractListModel>
+#include <QTimer>
 
 /**
  * @brief Model for TaskList.qml
@@ -20,6 +25,10 @@ class TaskModel : public QAbstractListModel
     Q_PROPERTY(int numTotal READ rowCount NOTIFY numTotalChanged)
     Q_PROPERTY(int numSelected READ numSelected NOTIFY numSelectedChanged)
     Q_PROPERTY(double numFinished READ numFinished NOTIFY numFinishedChanged)
+    Q_PROPERTY(int numInQueue READ numInQueue NOTIFY numStatusChanged)
+    Q_PROPERTY(int numInProcess READ numInProcess NOTIFY numStatusChanged)
+    Q_PROPERTY(int numRejected READ numRejected NOTIFY numRejectedChanged)
+    Q_PROPERTY(int updateInterval READ updateInterval WRITE setUpdateInterval NOTIFY updateIntervalChanged)
 
 public:
     /**
@@ -66,6 +75,27 @@ public:
      * @return Number of already finished tasks
      */
     int numFinished() const;
+
+    /**
+     * @brief Returns number of tasks that are not started yet (queued, paused or waiting for dependencies)
+     * Derived from counters of the pool, no rows are scanned
+     * @return Number of tasks in queue
+     */
+    int numInQueue() const;
+
+    /**
+     * @brief Returns number of started but not finished tasks
+     * @return Number of tasks in process
+     */
+    int numInProcess() const;
+
+    /**
+     * @brief Getters for description of the row (used by TaskFilterModel)
+     * @param row_idx Index of the row, should be valid
+     */
+    TaskTypes taskType(int row_idx) const { return static_cast<TaskTypes>(m_table.type(row_idx)); }
+    int taskArg(int row_idx) const { return m_table.arg(row_idx); }
+    TP::TaskStatus taskStatus(int row_idx) const { return m_table.status(row_idx); }
     
     /**
      * @brief Returns number of selected tasks (useful for GUI)
@@ -73,11 +103,38 @@ public:
      */
     int numSelected() const;
 
+    /**
+     * @brief Returns number of tasks rejected by admission control of the pool
+     * or refused by the model (arguments out of range of TP::TaskTable)
+     * @return Number of rejected tasks
+     */
+    int numRejected() const;
+
+    /**
+     * @brief Returns interval of GUI updates in milliseconds (see setUpdateInterval)
+     */
+    int updateInterval() const;
+
+    /**
+     * @brief Sets interval of GUI updates
+     * Status changes of tasks are collected and sent once per interval as dataChanged of contiguous row ranges
+     * with a single progress notification, so the GUI event loop is not flooded by thousands of updates per second
+     * @param interval_ms Interval in milliseconds (default - 16, about one display frame)
+     */
+    void setUpdateInterval(int interval_ms);
+
+    /**
+     * @brief Registers task functions for worker processes (see TP::ProcessBackend)
+     * Should be called at the beginning of main in every process
+     */
+    static void registerRemoteTasks();
+
 public slots:
     
     /**
      * @brief Creates task with given type and arguments.
-     * Puts it into thread pool and this model (m_tasks).
+     * Puts it into thread pool and this model (m_table).
+     * Arguments that do not fit into the table (see TP::TaskTable::fits) are refused
      * @param task_type Task type (from TaskTypes enum)
      * @param arg Argument of the task
      * @param enbl_emit Emit (true) or not (false) signal during insertion. 
@@ -85,6 +142,7 @@ public slots:
      * (for example calling this function in a loop, see addTasksRandom)
      * 
      * Emits numTotalChanged and calls insertRows
+     * Emits numRejectedChanged if the pool is full or the argument is refused
      * 
      * @return Success (true) or failure (false)
      */
@@ -92,6 +150,8 @@ public slots:
 
     /**
      * @brief Creates n random tasks of all available types (see TaskTypes)
+     * Tasks that do not fit into the pool limits are dropped, emits numRejectedChanged in that case
+     * All tasks are refused if [min_value, max_value] does not intersect the argument range of TP::TaskTable
      * @param n Number of tasks to create
      * @param min_value Minimum argument value
      * @param max_value Maximum argument value
@@ -106,6 +166,42 @@ public slots:
      */
     void removeTasks();
 
+    /**
+     * @brief Pauses selected tasks
+     * Queued tasks are held back, running tasks are paused at the end of their time slice
+     */
+    void pauseTasks();
+
+    /**
+     * @brief Resumes selected tasks paused previously
+     */
+    void resumeTasks();
+
+    /**
+     * @brief Cancels selected queued tasks that do not start within the timeout
+     * Cancelled tasks stay in the model as finished with an error (see TP::CancelledResult)
+     * @param timeout_ms Timeout in milliseconds since now
+     */
+    void cancelTasksIfNotStarted(int timeout_ms);
+
+    /**
+     * @brief Saves all tasks (type, argument, status) and results of completed tasks into the snapshot file
+     * Tasks that are not completed yet are saved without results and recomputed after restore
+     * @param path Path of the snapshot file (empty - default location in application data directory)
+     * @return Success (true) or failure (false)
+     */
+    bool saveSnapshot(const QString &path = QString());
+
+    /**
+     * @brief Appends tasks from the snapshot file
+     * The file is memory mapped, results of completed tasks are materialized only when displayed
+     * Not completed tasks are put into the thread pool again
+     * Emits numTotalChanged, numFinishedChanged and calls insertRows
+     * @param path Path of the snapshot file (empty - default location in application data directory)
+     * @return Success (true) or failure (false)
+     */
+    bool loadSnapshot(const QString &path = QString());
+
     /**
      * @brief Selects or deselects all tasks
      * @param select Select (true) or deselect(false)
@@ -113,12 +209,35 @@ public slots:
     void selectTasksAll(bool select);
 
     /**
-     * @brief Inserts mapping task_idx->row_idx into idMap
-     * !IMPORTANT This slot should be called with delegate (Component.onCompleted)
-     * Otherwise thread pool events will not affect GUI 
-     * @param row_idx Index of row where task located
+     * @brief Selects or deselects rows from first_row to last_row (inclusive)
+     * @param first_row First row
+     * @param last_row Last row
+     * @param select Select (true) or deselect(false)
+     */
+    void selectTasksRange(int first_row, int last_row, bool select);
+
+    /**
+     * @brief Starts worker processes, new tasks are executed there instead of this process
+     * Every process has its own heap, crashed worker fails its task and is respawned
+     * Tasks executed by worker processes can not be paused
+     * @param num_processes Number of worker processes
+     * @return Success (true) or failure (false)
+     */
+    bool startProcesses(int num_processes);
+
+    /**
+     * @brief Stops worker processes, queued remote tasks fail
+     * @return Success (true) or failure (false)
+     */
+    bool stopProcesses();
+
+    /**
+     * @brief Sets placement of worker threads, applied by the next startPool
+     * @param policy "none", "compact" or "scatter" (see TP::AffinityPolicy)
+     * @param bind_memory Allocate memory of pinned workers on their own NUMA node
+     * @return Success (true) or failure (false, unknown policy)
      */
-    void updateIdMap(int row_idx);
+    bool setPlacement(const QString &policy, bool bind_memory);
 
     /**
      * @brief Starts the thread pool with given number of threads
@@ -139,7 +258,7 @@ public slots:
 
 signals:
     /**
-     * @brief This signal is emitted after number of rows (m_tasks) have been changed
+     * @brief This signal is emitted after number of rows (m_table) have been changed
      * This signal is emitted when tasks are added
      * This signal is emitted when tasks are removed
     */
@@ -158,25 +277,125 @@ signals:
      * This signal is emitted when tasks are deleted 
     */
     void numFinishedChanged();
+
+    /**
+     * @brief This signal is emitted after submissions have been rejected by the pool (queue or memory limit)
+    */
+    void numRejectedChanged();
+
+    /**
+     * @brief This signal is emitted after number of tasks in some status (numInQueue, numInProcess) may have been changed
+     * This signal is emitted with numTotalChanged and numFinishedChanged, and when tasks start (once per update interval)
+    */
+    void numStatusChanged();
+
+    /**
+     * @brief This signal is emitted after the update interval has been changed
+    */
+    void updateIntervalChanged();
+
+    /**
+     * @brief This signal is emitted by a worker when the table gets the first update since the last flush
+     * Delivered to the GUI thread with queued connection (see scheduleFlush)
+    */
+    void updatesPending();
     
 private:
+    /**
+     * @brief Row that is going to be appended to m_table
+     */
+    struct NewRow
+    {
+        size_t id;
+        TaskTypes type;
+        int arg;
+        std::unique_ptr<TP::TaskResult> result; // restored result or nullptr
+    };
+
+    /**
+     * @brief Returns projected size of the result in bytes
+     */
+    static size_t taskCost(TaskTypes task_type, int arg);
+
+    /**
+     * @brief Puts task with given type and argument into thread pool
+     * The task writes its status and result into m_table
+     * @param task_idx Index of the task (output)
+     * @return Success (true) or failure (false, task type is unknown or the task is rejected by the pool)
+     */
+    bool submitTask(TaskTypes task_type, int arg, size_t &task_idx);
+
+    /**
+     * @brief Appends rows to the table, calls insertRows and emits numTotalChanged
+     */
+    void appendRows(std::vector<NewRow> &rows);
+
+    /**
+     * @brief Formats name of the task, e.g. Factorial(10)
+     */
+    static QString taskName(TaskTypes task_type, int arg);
+
+    /**
+     * @brief Returns row index of the task or -1 if there is no such row (binary search, ids of rows are increasing)
+     */
+    int rowById(size_t task_idx) const;
+
+    /**
+     * @brief Starts the flush timer unless it is running already, called in the GUI thread (see updatesPending)
+     */
+    void scheduleFlush();
+
+    /**
+     * @brief Emits dataChanged for rows updated since the last flush (merged into contiguous ranges)
+     * and progress signals if the counters have changed
+     */
+    void flushUpdates();
+
+    /**
+     * @brief Returns path of the snapshot file (default location if path is empty)
+     */
+    static QString snapshotPath(const QString &path);
+
+    // Worker processes, threads of the pool wait for them (destroyed after the pool)
+    TP::ProcessBackend m_processes;
+    bool m_processes_active = false;
+
+    // Tasks (one row per task, ordered by id), written by tasks of the pool (destroyed after the pool)
+    TP::TaskTable m_table;
+
+    // Tasks cancelled by timers of the pool, they are not counted as finished by the pool (destroyed after the pool)
+    std::atomic<size_t> m_num_cancelled = {0};
+
     // Instance of thread pool
     TP::ThreadPool m_pool;
 
-    // Containter that stores information about tasks
-    std::deque<std::unique_ptr<TP::ITaskInfo>> m_tasks;
+    // Worker placement used by startPool (see setPlacement)
+    TP::StartOptions m_start_options;
+
+    // Resource group of the pool for every task type (index - TaskTypes value)
+    std::vector<size_t> m_type_groups;
 
     // Task selection
-    std::unordered_set<size_t> m_selected; // ids of selected tasks
+    TP::SelectionSet m_selected; // ids of selected tasks
 
-    // Map that connects task ids to row indexes
-    std::mutex m_id_map_mtx;
-    std::unordered_map<size_t, size_t> m_id_map;
+    // Coalescing of updates (see setUpdateInterval)
+    QTimer m_flush_timer;
+    int m_update_interval = 16;
+
+    // Counters sent with the last flush
+    int m_flushed_finished = 0;
+    int m_flushed_in_process = 0;
 
     // Compensation for already finished removed tasks 
     // Useful to keep progress bar (numFinished) in valid state
     size_t m_num_finished_removed = 0;
 
+    // Number of completed tasks restored from snapshots (they are not counted by the pool)
+    size_t m_num_finished_restored = 0;
+
+    // Tasks refused before submission (arguments out of range of TP::TaskTable)
+    size_t m_num_refused = 0;
+
     // Random engine
     std::mt19937 m_rand_gen;
 };
\ No newline at end of file
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "make_string.hpp"
+#include "snapshot.hpp"
+#include "task_info.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gmpxx.h>
+
+namespace TP
+{
+    /**
+     * @brief Result of a completed task stored in TaskTable
+     */
+    class TaskResult
+    {
+    public:
+        virtual ~TaskResult() = default;
+
+        /**
+         * @brief Returns string representation of the result (see make_string)
+         */
+        virtual std::string str() const = 0;
+    };
+
+    /**
+     * @brief Result computed by the pool
+     */
+    class ValueResult : public TaskResult
+    {
+    public:
+        explicit ValueResult(mpz_class value) : m_value(std::move(value)) {}
+
+        std::string str() const { return make_string(m_value); }
+        const mpz_class &value() const { return m_value; }
+
+    private:
+        mpz_class m_value;
+    };
+
+    /**
+     * @brief Failed task (e.g. crashed worker process) shows the error instead of the result
+     */
+    class ErrorResult : public TaskResult
+    {
+    public:
+        explicit ErrorResult(std::string message) : m_message(std::move(message)) {}
+
+        std::string str() const { return "Error: " + m_message; }
+
+    private:
+        std::string m_message;
+    };
+
+    /**
+     * @brief Task removed by the pool before it started (see ThreadPool::cancel_if_not_started)
+     * Its memory budget has been released by the pool already
+     */
+    class CancelledResult : public ErrorResult
+    {
+    public:
+        CancelledResult() : ErrorResult("cancelled, not started in time") {}
+    };
+
+    /**
+     * @brief Result of completed task restored from the snapshot, materialized only when requested
+     */
+    class SnapshotResult : public TaskResult
+    {
+    public:
+        SnapshotResult(std::shared_ptr<const Snapshot> snapshot, size_t pos) : m_snapshot(std::move(snapshot)), m_pos(pos) {}
+
+        std::string str() const { return make_string(m_snapshot->result(m_pos)); }
+
+        /**
+         * @brief Getters for the snapshot and position of the record
+         */
+        const Snapshot &snapshot() const { return *m_snapshot; }
+        size_t pos() const { return m_pos; }
+
+    private:
+        std::shared_ptr<const Snapshot> m_snapshot;
+        size_t m_pos;
+    };
+
+    /**
+     * @brief Struct-of-arrays table of tasks ordered by id
+     * Every row is an id, type and argument packed into 32 bits, a status byte and a result pointer
+     * (nullptr till the task is completed), so a queued task takes about 21 bytes.
+     *
+     * Rows are appended and removed by the owner thread only, it could read ids, types and arguments
+     * without locking. Status and result are written by workers (by task id, see ThreadPool::current_task_id),
+     * so they are accessed under the table mutex. A task could start before its row is appended,
+     * such updates are kept aside and applied by append.
+     *
+     * Ids of updated tasks are collected under the same mutex, the owner takes them in batches (see take_dirty)
+     * instead of handling every update separately.
+     */
+    class TaskTable
+    {
+    public:
+        // Argument shares 32 bits with the type
+        static const int kTypeBits = 4;
+        static const int32_t kMinArg = INT32_MIN / (1 << kTypeBits);
+        static const int32_t kMaxArg = INT32_MAX / (1 << kTypeBits);
+
+        /**
+         * @brief Getters for columns, owner thread only
+         * @param row Index of the row, should be valid
+         */
+        size_t size() const { return m_ids.size(); }
+        bool empty() const { return m_ids.empty(); }
+        uint64_t id(size_t row) const { return m_ids[row]; }
+        uint32_t type(size_t row) const { return m_keys[row] & ((1u << kTypeBits) - 1); }
+        int32_t arg(size_t row) const { return static_cast<int32_t>(m_keys[row]) >> kTypeBits; }
+
+        /**
+         * @brief Returns status of the task
+         * @param row Index of the row, should be valid
+         */
+        TaskStatus status(size_t row) const;
+
+        /**
+         * @brief Returns result of the task, owner thread only
+         * @param row Index of the row, should be valid
+         * @return Result or nullptr if the task is not completed, valid till the row is removed
+         */
+        const TaskResult *result(size_t row) const;
+
+        /**
+         * @brief Returns string representation of the result or an empty string if the task is not completed
+         * The result is formatted without holding the table mutex
+         * @param row Index of the row, should be valid
+         */
+        std::string result_str(size_t row) const;
+
+        /**
+         * @brief Returns index of the first row with id not less than the given one (binary search)
+         */
+        size_t lower_bound(uint64_t id) const;
+
+        /**
+         * @brief Finds row of the task, owner thread only
+         * @param id Task index
+         * @param row Row index (output)
+         * @return Found (true) or not (false)
+         */
+        bool find(uint64_t id, size_t &row) const;
+
+        /**
+         * @brief Checks if the argument could be stored in the table
+         */
+        static bool fits(int32_t arg) { return arg >= kMinArg && arg <= kMaxArg; }
+
+        /**
+         * @brief Appends row, owner thread only
+         * @param id Task index, should be greater than ids of all rows
+         * @param type Task type (owner specific, less than 2^kTypeBits)
+         * @param arg Task argument (see fits)
+         * @param result Result of already completed task or nullptr
+         */
+        void append(uint64_t id, uint32_t type, int32_t arg, std::unique_ptr<TaskResult> &&result = nullptr);
+
+        /**
+         * @brief Removes rows for which pred(row, status, result) returns true, owner thread only
+         * The table mutex is locked, pred could use only getters that do not lock it (id, type, arg)
+         * @return Number of removed rows
+         */
+        template <typename Pred>
+        size_t remove_if(Pred pred);
+
+        /**
+         * @brief Marks the task as started (InQueue -> InProcess), could be called by any thread
+         * @param id Task index
+         */
+        void set_started(uint64_t id);
+
+        /**
+         * @brief Stores result of the task and marks it as completed, could be called by any thread
+         * @param id Task index
+         * @param result Result of the task
+         */
+        void set_result(uint64_t id, std::unique_ptr<TaskResult> &&result);
+
+        /**
+         * @brief Sets function that is called when a task is updated and there were no updates since the last take_dirty
+         * Called by the updating thread without the table mutex, so it should only schedule take_dirty
+         * Should be set by the owner before tasks are submitted
+         * @param callback Callback function
+         */
+        void set_dirty_callback(std::function<void()> callback) { m_dirty_callback = std::move(callback); }
+
+        /**
+         * @brief Takes ids of tasks updated since the last call (in order of updates, could repeat), owner thread only
+         * Ids of rows removed since the update could be among them, updates of rows that are not appended yet are not reported
+         */
+        std::vector<uint64_t> take_dirty();
+
+    private:
+        /**
+         * @brief Update of a task that has no row yet
+         */
+        struct Pending
+        {
+            TaskStatus status = TaskStatus::InQueue;
+            std::unique_ptr<TaskResult> result;
+        };
+
+        /**
+         * @brief Finds row of the task or its pending update if the row is not appended yet
+         * m_mtx should be locked by the caller
+         * @param id Task index
+         * @param row Row index (output)
+         * @return Found row (true) or not (false), in the latter case pending is set unless the row has been removed
+         */
+        bool find_locked(uint64_t id, size_t &row, Pending *&pending);
+
+        /**
+         * @brief Adds id of the updated task, m_mtx should be locked by the caller
+         * @return The first update since the last take_dirty (true) or not (false)
+         */
+        bool mark_dirty(uint64_t id);
+
+        /**
+         * @brief Calls the dirty callback if needed, m_mtx should not be locked
+         */
+        void notify_dirty(bool first);
+
+        mutable std::mutex m_mtx;
+
+        // Columns
+        std::vector<uint64_t> m_ids;
+        std::vector<uint32_t> m_keys;   // type | arg << kTypeBits
+        std::vector<uint8_t> m_status;  // TaskStatus
+        std::vector<std::unique_ptr<TaskResult>> m_results;
+
+        // Updates of tasks that started before their rows were appended
+        std::map<uint64_t, Pending> m_pending;
+
+        // Ids of updated tasks and the owner's callback
+        std::vector<uint64_t> m_dirty;
+        std::function<void()> m_dirty_callback;
+    };
+
+    template <typename Pred>
+    size_t TaskTable::remove_if(Pred pred)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        // Compact all columns at once
+        size_t dst = 0;
+        for (size_t src = 0; src < m_ids.size(); src++)
+        {
+            if (pred(src, static_cast<TaskStatus>(m_status[src]), m_results[src].get()))
+                continue;
+            if (dst != src)
+            {
+                m_ids[dst] = m_ids[src];
+                m_keys[dst] = m_keys[src];
+                m_status[dst] = m_status[src];
+                m_results[dst] = std::move(m_results[src]);
+            }
+            dst++;
+        }
+
+        size_t removed = m_ids.size() - dst;
+        m_ids.resize(dst);
+        m_keys.resize(dst);
+        m_status.resize(dst);
+        m_results.resize(dst);
+        return removed;
+    }
+}
@@ -1,44 +1,184 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstddef>
 #include <gmpxx.h>
 
 namespace tasks
 {
-    
-    inline mpz_class fib(int n)
+    /**
+     * @brief Resumable fibonacci (see TP::ThreadPool::add_resumable_task)
+     * State: loop index and two previous numbers
+     */
+    class FibJob
     {
-        if (n <= 1)
-            return n;
-        mpz_class prev2(0);
-        mpz_class prev1(1);
-        mpz_class cur;
-        for (int i = 2; i <= n; i++)
+    public:
+        explicit FibJob(int n) : m_n(n), m_prev2(0), m_prev1(1), m_i(2) {}
+
+        /**
+         * @brief Continues computations until deadline
+         * @param deadline Time to yield back to the scheduler
+         * @return Finished (true) or not (false)
+         */
+        bool step(std::chrono::steady_clock::time_point deadline)
         {
-            cur = prev2 + prev1;
-            prev2 = prev1;
-            prev1 = cur;
+            while (m_i <= m_n)
+            {
+                // Check the clock once per chunk of iterations
+                for (int end = std::min(m_n, m_i + kChunk); m_i <= end; m_i++)
+                {
+                    m_prev2 += m_prev1;
+                    swap(m_prev1, m_prev2);
+                }
+                if (std::chrono::steady_clock::now() >= deadline)
+                    break;
+            }
+            return m_i > m_n;
         }
-        return cur;
-    }
 
-    inline mpz_class factorial(int n)
+        /**
+         * @brief Returns result of finished job
+         */
+        mpz_class result() const { return (m_n <= 1) ? mpz_class(m_n) : m_prev1; }
+
+    private:
+        static const int kChunk = 1024;
+
+        int m_n;
+        mpz_class m_prev2;
+        mpz_class m_prev1;
+        int m_i;
+    };
+
+    /**
+     * @brief Resumable product of first, first + stride, ..., up to last
+     * (factorial and double factorial, see TP::ThreadPool::add_resumable_task)
+     * State: loop index and accumulator
+     *
+     * Runs of small factors are packed into machine words until the next factor would overflow,
+     * the words of a chunk are multiplied by a balanced product tree and the accumulator is multiplied
+     * once per chunk instead of once per factor
+     */
+    class ProductJob
     {
-        mpz_class res(1);
-        for (int i = 1; i <= n; i++)
+    public:
+        ProductJob(int first, int last, int stride) : m_i(first), m_last(last), m_stride(stride), m_acc(1) {}
+
+        /**
+         * @brief Continues computations until deadline
+         * @param deadline Time to yield back to the scheduler
+         * @return Finished (true) or not (false)
+         */
+        bool step(std::chrono::steady_clock::time_point deadline)
+        {
+            // Non-positive factors do not fit into unsigned words
+            for (; m_i <= m_last && m_i <= 0; m_i += m_stride)
+            {
+                m_acc *= m_i;
+            }
+
+            unsigned long words[kChunk];
+            while (m_i <= m_last)
+            {
+                int n = 0;
+                for (; n < kChunk && m_i <= m_last; n++)
+                {
+                    unsigned long word = 1;
+                    for (; m_i <= m_last && word <= ULONG_MAX / m_i; m_i += m_stride)
+                    {
+                        word *= m_i;
+                    }
+                    words[n] = word;
+                }
+                m_acc *= word_product(words, n);
+
+                // Check the clock once per chunk of words
+                if (std::chrono::steady_clock::now() >= deadline)
+                    break;
+            }
+            return m_i > m_last;
+        }
+
+        /**
+         * @brief Returns result of finished job
+         */
+        const mpz_class &result() const { return m_acc; }
+
+    private:
+        static const int kChunk = 256;
+
+        /**
+         * @brief Multiplies n words, halves of similar size keep GMP in its fast multiplication range
+         */
+        static mpz_class word_product(const unsigned long *words, int n)
         {
-            res *= i;
+            if (n == 0)
+                return 1;
+            if (n == 1)
+                return mpz_class(words[0]);
+            if (n == 2)
+                return mpz_class(words[0]) * words[1];
+            return word_product(words, n / 2) * word_product(words + n / 2, n - n / 2);
         }
-        return res;
+
+        int m_i;
+        int m_last;
+        int m_stride;
+        mpz_class m_acc;
+    };
+
+    inline FibJob fib_job(int n) { return FibJob(n); }
+    inline ProductJob factorial_job(int n) { return ProductJob(1, n, 1); }
+    inline ProductJob double_factorial_job(int n) { return ProductJob((n % 2 == 0) ? 2 : 1, n, 2); }
+
+    /**
+     * @brief Projected size of results in bytes (see TP::TaskOptions::cost_bytes)
+     * Estimated from the number of bits: n * log2(phi) for fibonacci, log2(n!) via lgamma for factorials
+     */
+    inline size_t bits_to_bytes(double bits) { return static_cast<size_t>(std::max(bits, 0.0) / 8) + sizeof(mpz_class); }
+
+    inline size_t fib_bytes(int n) { return bits_to_bytes(n * 0.6942419136306174); }
+
+    inline double log2_factorial(int n) { return (n <= 1) ? 0 : std::lgamma(n + 1.0) / std::log(2.0); }
+
+    inline size_t factorial_bytes(int n) { return bits_to_bytes(log2_factorial(n)); }
+
+    inline size_t double_factorial_bytes(int n)
+    {
+        // (2k)!! = 2^k * k!, (2k+1)!! = (2k+1)! / (2k)!!
+        if (n % 2 == 0)
+            return bits_to_bytes(n / 2 + log2_factorial(n / 2));
+        return bits_to_bytes(log2_factorial(n) - ((n - 1) / 2 + log2_factorial((n - 1) / 2)));
     }
 
-    inline mpz_class double_factorial(int n)
+    /**
+     * @brief Runs resumable job till the end on the calling thread
+     */
+    template <typename Job>
+    inline mpz_class run_job(Job &&job)
     {
-        mpz_class res(1);
-        for (int i = n; i >= 1; i -= 2)
+        while (!job.step(std::chrono::steady_clock::time_point::max()))
         {
-            res *= i;
         }
-        return res;
+        return job.result();
+    }
+
+    inline mpz_class fib(int n)
+    {
+        return run_job(fib_job(n));
+    }
+
+    inline mpz_class factorial(int n)
+    {
+        return run_job(factorial_job(n));
+    }
+
+    inline mpz_class double_factorial(int n)
+    {
+        return run_job(double_factorial_job(n));
     }
 
-}
\ No newline at end of file
+}
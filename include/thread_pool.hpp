@@ -2,16 +2,245 @@
 
 #include "task_info.hpp"
 #include "async_event.hpp"
+#include "completion_queue.hpp"
+#include "cpu_topology.hpp"
+#include "selection_set.hpp"
+#include "timer_wheel.hpp"
 
 #include <deque>
+#include <string>
+#include <vector>
 #include <unordered_set>
+#include <unordered_map>
 #include <memory>
 #include <future>
 #include <type_traits>
 #include <atomic>
+#include <chrono>
+#include <functional>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
 
 namespace TP
 {
+    /**
+     * @brief Return type of a call, Sig is Func(Args...)
+     * std::result_of is deprecated in C++17 and removed in C++20 (coroutine builds)
+     */
+#if __cplusplus >= 201703L
+    template <typename Sig>
+    struct result_of;
+
+    template <typename Func, typename... Args>
+    struct result_of<Func(Args...)> : std::invoke_result<Func, Args...>
+    {
+    };
+#else
+    template <typename Sig>
+    struct result_of : std::result_of<Sig>
+    {
+    };
+#endif
+
+    template <typename Sig>
+    using result_of_t = typename result_of<Sig>::type;
+
+    /**
+     * @brief What an idle worker does before parking on the condition variable
+     * Spinning avoids futex wakeup and context switch for bursts of tiny tasks
+     * CPU burn is bounded by spin_count + yield_count iterations per idle period
+     *
+     * Opt-in: by default workers park immediately. Spinning pays off only when submitters run on other
+     * cores and tasks are shorter than a futex wakeup (see the "idle" bench scenario), on a single core
+     * or an oversubscribed host it takes CPU time from the submitter instead
+     */
+    struct IdleStrategy
+    {
+        // Number of busy-wait iterations (with pause instruction)
+        size_t spin_count = 0;
+
+        // Number of std::this_thread::yield calls after spinning
+        size_t yield_count = 0;
+    };
+
+    /**
+     * @brief Options of ThreadPool::start
+     * Placement only pins workers and their memory, all workers still share the same task queues
+     * (there are no per-node queues and no stealing restricted to the node)
+     */
+    struct StartOptions
+    {
+        // Placement of worker threads on CPU cores
+        AffinityPolicy affinity = AffinityPolicy::None;
+
+        // Allocate memory of pinned workers on their own NUMA node
+        bool bind_memory = false;
+
+        // Behaviour of workers when the queue is empty
+        IdleStrategy idle;
+
+        // Time quantum of resumable tasks (see ThreadPool::add_resumable_task)
+        std::chrono::microseconds time_slice = std::chrono::milliseconds(10);
+    };
+
+    /**
+     * @brief What happens with submission when the queue is full
+     */
+    enum class AdmissionPolicy
+    {
+        Block,  // Wait until there is space
+        TryFor, // Wait up to QueueLimits::timeout, then reject
+        Reject  // Reject immediately
+    };
+
+    /**
+     * @brief Limits of admission control (0 - unlimited)
+     */
+    struct QueueLimits
+    {
+        // Maximum number of admitted tasks that have not started yet
+        size_t max_tasks = 0;
+
+        // Maximum projected memory of results of admitted tasks (see TaskOptions::cost_bytes)
+        // Memory of finished tasks is accounted until ThreadPool::release_bytes is called
+        size_t max_bytes = 0;
+
+        // Submission policy and wait timeout for AdmissionPolicy::TryFor
+        AdmissionPolicy policy = AdmissionPolicy::Block;
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(0);
+    };
+
+    /**
+     * @brief Options of task submission
+     */
+    struct TaskOptions
+    {
+        // Tasks of the same pool that have to be completed first
+        // Rejected (not valid) tasks never run and are treated as completed
+        std::vector<const ITaskInfo *> deps;
+
+        // Projected memory of the result in bytes (used by admission control)
+        size_t cost_bytes = 0;
+
+        // Resource group of the task (see ThreadPool::add_group), 0 - default group
+        size_t group = 0;
+
+        // Submitting client of the task (see ThreadPool::add_client), 0 - default client
+        size_t client = 0;
+
+        // Queue the index of the task is pushed into when it finishes or is removed (nullptr - none)
+        std::shared_ptr<CompletionQueue> completion;
+    };
+
+    /**
+     * @brief Statistics of a submitting client (see ThreadPool::client_stats)
+     */
+    struct ClientStats
+    {
+        std::string name;
+        size_t weight = 1;
+
+        // Tasks in the queue of the client right now
+        size_t queued = 0;
+
+        // Tracked tasks that have started and finished
+        size_t started = 0;
+        size_t finished = 0;
+
+        // Time from queueing to start (paused time and waiting for dependencies are not counted)
+        std::chrono::microseconds total_wait = std::chrono::microseconds(0);
+        std::chrono::microseconds max_wait = std::chrono::microseconds(0);
+    };
+
+    /**
+     * @brief Shared state of resumable task: the job and promise for its result
+     * Job should provide bool step(std::chrono::steady_clock::time_point deadline)
+     * that returns true when finished, and result()
+     */
+    template <typename Job, typename RET>
+    struct ResumableState
+    {
+        Job job;
+        std::promise<RET> promise;
+
+        explicit ResumableState(Job &&job) : job(std::move(job)) {}
+
+        /**
+         * @brief Runs the job until deadline
+         * @return Finished (true) or not (false)
+         */
+        bool step(std::chrono::steady_clock::time_point deadline)
+        {
+            try
+            {
+                if (!job.step(deadline))
+                    return false;
+                promise.set_value(job.result());
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+            return true;
+        }
+    };
+
+    template <typename Job>
+    struct ResumableState<Job, void>
+    {
+        Job job;
+        std::promise<void> promise;
+
+        explicit ResumableState(Job &&job) : job(std::move(job)) {}
+
+        bool step(std::chrono::steady_clock::time_point deadline)
+        {
+            try
+            {
+                if (!job.step(deadline))
+                    return false;
+                job.result();
+                promise.set_value();
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief Callable that passes result of a finished task into the next function
+     * Used by ThreadPool::then, input is always ready when the continuation is called
+     */
+    template <typename T, typename Func>
+    struct Continuation
+    {
+        std::shared_future<T> input;
+        Func func;
+
+        auto operator()() -> decltype(func(input.get()))
+        {
+            return func(input.get());
+        }
+    };
+
+    template <typename Func>
+    struct Continuation<void, Func>
+    {
+        std::shared_future<void> input;
+        Func func;
+
+        auto operator()() -> decltype(func())
+        {
+            input.get();
+            return func();
+        }
+    };
+
     /**
      * @brief Thread pool class
     */
@@ -25,22 +254,110 @@ namespace TP
             size_t idx;
             std::packaged_task<void()> task;
             std::promise<void> start_promise;
+            bool tracked; // produces events and counted in num_finished
+
+            // Resumable tasks run by time slices instead of task
+            std::function<bool(std::chrono::steady_clock::time_point)> step;
+            bool started = false;
+
+            // Projected memory of the result (see TaskOptions::cost_bytes)
+            size_t cost = 0;
+
+            // Resource group (index of m_groups) and client (index of m_clients)
+            size_t group = 0;
+            size_t client = 0;
+
+            // Time the task has been put into the ready queue
+            std::chrono::steady_clock::time_point queued_at;
+
+            // Completion queue of the task (see TaskOptions::completion)
+            std::shared_ptr<CompletionQueue> completion;
 
             template <typename Task, typename StartPromise>
             QueueElement(size_t idx,
                          Task &&task,
-                         StartPromise &&start_promise) : idx(idx),
-                                                         task(std::forward<Task>(task)),
-                                                         start_promise(std::forward<StartPromise>(start_promise)) {}
+                         StartPromise &&start_promise,
+                         bool tracked = true) : idx(idx),
+                                                task(std::forward<Task>(task)),
+                                                start_promise(std::forward<StartPromise>(start_promise)),
+                                                tracked(tracked) {}
+        };
+
+        /**
+         * @brief Utility struct, used for storing tasks waiting for their dependencies
+        */
+        struct WaitingElement
+        {
+            QueueElement element;
+            std::vector<size_t> deps; // indices of unfinished dependencies at submission
+            size_t remaining;         // number of still unfinished dependencies
+        };
+
+        /**
+         * @brief Utility struct, used for storing tasks waiting for their timers (see add_delayed_task)
+        */
+        struct DelayedElement
+        {
+            QueueElement element;
+            uint64_t timer_id;
+        };
+
+        /**
+         * @brief Ready tasks of one client in one group
+         */
+        struct TaskQueue
+        {
+            std::deque<QueueElement> tasks;
+
+            // Requeued resumable tasks break ordering by index of tasks
+            bool sorted = true;
+        };
+
+        /**
+         * @brief Resource group: concurrency limit shared by tasks of all clients
+         */
+        struct Group
+        {
+            std::string name;
+            size_t max_running; // 0 - unlimited
+            size_t running = 0; // tasks being executed by workers right now
+            size_t queued = 0;  // ready tasks of all clients
+
+            Group(const std::string &name, size_t max_running) : name(name), max_running(max_running) {}
+        };
+
+        /**
+         * @brief Submitting client: own queue in every group and share of workers proportional to its weight
+         */
+        struct Client
+        {
+            std::string name;
+            size_t weight;
+            size_t deficit = 0;    // tasks the client could still take in its current turn
+            size_t next_group = 0; // group to be checked first (round-robin)
+            size_t queued = 0;     // ready tasks in all groups
+            std::deque<TaskQueue> queues; // index - group, deque: queues are not relocated when added
+            ClientStats stats;
+
+            Client(const std::string &name, size_t weight) : name(name), weight(weight ? weight : 1) {}
         };
 
     public:
+        // Returned by current_task_id outside of tasks
+        static const size_t kNoTask = static_cast<size_t>(-1);
+
+        /**
+         * @brief Constructor, creates the default resource group (unlimited)
+         */
+        ThreadPool();
+
         /**
          * @brief Starts the thread pool with given number of threads
          * @param num_threads Threads in thread pool
+         * @param options Worker placement options (see StartOptions)
          * @return Success (true) or failure (false)
          */
-        bool start(size_t num_threads);
+        bool start(size_t num_threads, const StartOptions &options = StartOptions());
 
         /**
          * @brief Stops the thread pool
@@ -58,9 +375,12 @@ namespace TP
 
         /**
          * @brief Removes tasks by given task indices
+         * Tasks that other queued tasks depend on are not removed, untracked jobs (see post) are never removed
          * @param idxs Set of indices of tasks to be removed
+         * On return contains indices of tasks that were not removed
          */
         void remove_tasks(std::unordered_set<size_t> &idxs);
+        void remove_tasks(SelectionSet &idxs);
 
         /**
          * @brief Adds task to the queue
@@ -68,8 +388,22 @@ namespace TP
          * @param args Arguments of the task (variadic)
          * @return TaskInfo<RET>, where RET - return type of func
          */
-        template <typename Func, typename... Args, typename RET = typename std::result_of<Func(Args...)>::type>
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
         auto add_task(Func &&func, Args &&...args) -> TaskInfo<RET>
+        {
+            return add_task(TaskOptions(), std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Adds task to the queue with submission options
+         * @param options Dependencies and cost of the task (see TaskOptions)
+         * @param func Task function
+         * @param args Arguments of the task (variadic)
+         * @return TaskInfo<RET>, where RET - return type of func
+         * If the task is rejected by admission control (see QueueLimits) TaskInfo is not valid
+         */
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
+        auto add_task(const TaskOptions &options, Func &&func, Args &&...args) -> TaskInfo<RET>
         {
             // Get task unique index
             size_t task_idx = m_last_idx++;
@@ -81,30 +415,396 @@ namespace TP
             // Create promise that will be fulfilled when the task starts executing
             std::promise<void> start_promise;
 
+            // Wait for space in the queue
+            std::unique_lock<std::mutex> q_lock(m_queue_mtx);
+            if (!admit(q_lock, options.cost_bytes))
+                return TaskInfo<RET>(task_idx, std::future<void>(), std::future<RET>());
+
             // Create TaskInfo
             TaskInfo<RET> info(task_idx, start_promise.get_future(), task.get_future());
 
             // Populate containers
-            std::lock_guard<std::mutex> q_lock(m_queue_mtx);
-            m_tasks.emplace_back(task_idx, std::move(task), std::move(start_promise));
-            m_queue_cv.notify_one();
+            QueueElement element(task_idx, std::move(task), std::move(start_promise));
+            element.cost = options.cost_bytes;
+            element.group = options.group;
+            element.client = options.client;
+            element.completion = options.completion;
+            enqueue(std::move(element), options.deps);
+
+            return info;
+        }
+
+        /**
+         * @brief Adds task that is released to the queue when all its dependencies are completed
+         * Workers never block on dependencies, the task is queued by the worker that finishes the last one
+         * @param deps Tasks of this pool that have to be completed first (rejected tasks are treated as completed)
+         * @param func Task function
+         * @param args Arguments of the task (variadic)
+         * @return TaskInfo<RET>, where RET - return type of func
+         */
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
+        auto add_task_after(const std::vector<const ITaskInfo *> &deps, Func &&func, Args &&...args) -> TaskInfo<RET>
+        {
+            TaskOptions options;
+            options.deps = deps;
+            return add_task(options, std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Adds task that is put into the queue after the delay
+         * The task is admitted at submission (see QueueLimits), so a pending delayed task holds its slot
+         * Pending delayed tasks could be removed and paused as queued ones
+         * @param options Cost and group of the task (see TaskOptions), dependencies are not supported
+         * @param delay Delay after which the task is queued
+         * @param func Task function
+         * @param args Arguments of the task (variadic)
+         * @return TaskInfo<RET>, where RET - return type of func
+         * If the task is rejected by admission control (see QueueLimits) TaskInfo is not valid
+         */
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
+        auto add_delayed_task(const TaskOptions &options, std::chrono::milliseconds delay, Func &&func, Args &&...args) -> TaskInfo<RET>
+        {
+            // Get task unique index
+            size_t task_idx = m_last_idx++;
+
+            // Create packaged task
+            auto task = std::packaged_task<RET()>(
+                std::bind(std::forward<Func>(func), std::forward<Args>(args)...));
+
+            // Create promise that will be fulfilled when the task starts executing
+            std::promise<void> start_promise;
+
+            // Wait for space in the queue
+            std::unique_lock<std::mutex> q_lock(m_queue_mtx);
+            if (!admit(q_lock, options.cost_bytes))
+                return TaskInfo<RET>(task_idx, std::future<void>(), std::future<RET>());
+
+            // Create TaskInfo
+            TaskInfo<RET> info(task_idx, start_promise.get_future(), task.get_future());
+
+            // Put the task aside till its timer fires
+            QueueElement element(task_idx, std::move(task), std::move(start_promise));
+            element.cost = options.cost_bytes;
+            element.group = options.group;
+            element.client = options.client;
+            element.completion = options.completion;
+            schedule_delayed(std::move(element), delay);
+
+            return info;
+        }
+
+        /**
+         * @brief Adds task that is put into the queue after the delay
+         * @param delay Delay after which the task is queued
+         * @param func Task function
+         * @param args Arguments of the task (variadic)
+         * @return TaskInfo<RET>, where RET - return type of func
+         */
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
+        auto add_delayed_task(std::chrono::milliseconds delay, Func &&func, Args &&...args) -> TaskInfo<RET>
+        {
+            return add_delayed_task(TaskOptions(), delay, std::forward<Func>(func), std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Posts untracked job (see post) every period
+         * A run is skipped if the previous one has not finished yet, so slow jobs do not pile up in the queue
+         * @param period Period of runs, the first run is after one period
+         * @param func Job function
+         * @return Timer id for cancel_timer, 0 if the period is not positive
+         */
+        uint64_t add_periodic_task(std::chrono::milliseconds period, std::function<void()> func);
+
+        /**
+         * @brief Removes the task if it has not started within the timeout
+         * Started tasks (including paused resumable ones) and tasks that others depend on are kept
+         * The removed task is reported to completion queues (its future holds std::future_error)
+         * @param idx Task index (see TaskInfo::id)
+         * @param timeout Timeout since now
+         * @param on_cancelled Called with idx from the timer thread if the task has been removed (optional),
+         * owners of the task (e.g. TaskModel) update its state there
+         * @return Timer id for cancel_timer
+         */
+        uint64_t cancel_if_not_started(size_t idx, std::chrono::milliseconds timeout,
+                                       std::function<void(size_t)> on_cancelled = nullptr);
+
+        /**
+         * @brief Cancels timer of add_periodic_task or cancel_if_not_started
+         * @param timer_id Timer id
+         * @return Success (true) or failure (false, one-shot timer has fired already or unknown id)
+         */
+        bool cancel_timer(uint64_t timer_id);
+
+        /**
+         * @brief Returns number of pending timers (delayed tasks, periodic tasks and start timeouts)
+         * @returns Number of timers
+        */
+        inline size_t num_timers() const
+        {
+            return m_timers.size();
+        }
+
+        /**
+         * @brief Adds resumable task, that is executed by time slices (see StartOptions::time_slice)
+         * After every slice the task goes to the back of the queue, so short tasks are not stuck
+         * behind huge ones. Resumable tasks could be paused and resumed (see pause_tasks)
+         * @param job Object with explicit state, see ResumableState for requirements
+         * @return TaskInfo<RET>, where RET - return type of job.result()
+         */
+        template <typename Job, typename RET = typename std::decay<decltype(std::declval<Job &>().result())>::type>
+        auto add_resumable_task(Job &&job) -> TaskInfo<RET>
+        {
+            return add_resumable_task(TaskOptions(), std::forward<Job>(job));
+        }
+
+        /**
+         * @brief Adds resumable task with submission options
+         * @param options Dependencies and cost of the task (see TaskOptions)
+         * @param job Object with explicit state, see ResumableState for requirements
+         * @return TaskInfo<RET>, where RET - return type of job.result()
+         * If the task is rejected by admission control (see QueueLimits) TaskInfo is not valid
+         */
+        template <typename Job, typename RET = typename std::decay<decltype(std::declval<Job &>().result())>::type>
+        auto add_resumable_task(const TaskOptions &options, Job &&job) -> TaskInfo<RET>
+        {
+            // Get task unique index
+            size_t task_idx = m_last_idx++;
+
+            // Create shared state of the job
+            auto state = std::make_shared<ResumableState<typename std::decay<Job>::type, RET>>(std::forward<Job>(job));
+
+            // Create promise that will be fulfilled when the task starts executing
+            std::promise<void> start_promise;
+
+            // Wait for space in the queue
+            std::unique_lock<std::mutex> q_lock(m_queue_mtx);
+            if (!admit(q_lock, options.cost_bytes))
+                return TaskInfo<RET>(task_idx, std::future<void>(), std::future<RET>());
+
+            // Create TaskInfo
+            TaskInfo<RET> info(task_idx, start_promise.get_future(), state->promise.get_future());
+
+            // Populate containers
+            QueueElement element(task_idx, std::packaged_task<void()>(), std::move(start_promise));
+            element.step = [state](std::chrono::steady_clock::time_point deadline)
+            { return state->step(deadline); };
+            element.cost = options.cost_bytes;
+            element.group = options.group;
+            element.client = options.client;
+            element.completion = options.completion;
+            enqueue(std::move(element), options.deps);
 
             return info;
         }
 
+        /**
+         * @brief Wrapper for add_resumable_task, return unique_ptr to TaskInfo
+         * @param options Dependencies and cost of the task (see TaskOptions)
+         * @param job Object with explicit state, see ResumableState for requirements
+         * @return std::unique_ptr<TaskInfo<RET>>, where RET - return type of job.result()
+         * nullptr if the task is rejected by admission control
+         */
+        template <typename Job, typename RET = typename std::decay<decltype(std::declval<Job &>().result())>::type>
+        auto add_resumable_task_uptr(const TaskOptions &options, Job &&job) -> std::unique_ptr<TaskInfo<RET>>
+        {
+            TaskInfo<RET> info = add_resumable_task(options, std::forward<Job>(job));
+            if (!info.valid())
+                return nullptr;
+            return std::unique_ptr<TaskInfo<RET>>(new TaskInfo<RET>(std::move(info)));
+        }
+
+        /**
+         * @brief Wrapper for add_resumable_task, return unique_ptr to TaskInfo
+         * @param job Object with explicit state, see ResumableState for requirements
+         * @return std::unique_ptr<TaskInfo<RET>>, where RET - return type of job.result()
+         */
+        template <typename Job, typename RET = typename std::decay<decltype(std::declval<Job &>().result())>::type>
+        auto add_resumable_task_uptr(Job &&job) -> std::unique_ptr<TaskInfo<RET>>
+        {
+            return add_resumable_task_uptr(TaskOptions(), std::forward<Job>(job));
+        }
+
+        /**
+         * @brief Pauses tasks by given task indices
+         * Queued tasks are moved aside immediately, running resumable tasks are paused after their current slice
+         * Running ordinary tasks and untracked jobs (see post) can not be paused
+         * @param idxs Set of indices of tasks to be paused
+         */
+        void pause_tasks(const std::unordered_set<size_t> &idxs);
+        void pause_tasks(const SelectionSet &idxs);
+
+        /**
+         * @brief Resumes tasks paused by pause_tasks
+         * @param idxs Set of indices of tasks to be resumed
+         */
+        void resume_tasks(const std::unordered_set<size_t> &idxs);
+        void resume_tasks(const SelectionSet &idxs);
+
+        /**
+         * @brief Adds continuation, that receives result of the given task
+         * @param prev Task of this pool
+         * @param func Function that takes result of prev (or nothing if prev is void)
+         * @return TaskInfo<RET>, where RET - return type of func
+         */
+        template <typename T, typename Func,
+                  typename RET = result_of_t<Continuation<T, typename std::decay<Func>::type>()>>
+        auto then(const TaskInfo<T> &prev, Func &&func) -> TaskInfo<RET>
+        {
+            return add_task_after({&prev},
+                                  Continuation<T, typename std::decay<Func>::type>{prev.future(), std::forward<Func>(func)});
+        }
+
         /**
          * @brief Wrapper for add_task, return unique_ptr to TaskInfo
          * @param func Task function
          * @param Arguments of the task (variadic)
          * @return std::unique_ptr<TaskInfo<RET>>, where RET - return type of func
+         * nullptr if the task is rejected by admission control
          */
-        template <typename Func, typename... Args, typename RET = typename std::result_of<Func(Args...)>::type>
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
         auto add_task_uptr(Func &&func, Args &&...args) -> std::unique_ptr<TaskInfo<RET>>
         {
-            return std::unique_ptr<TaskInfo<RET>>(
-                new TaskInfo<RET>(add_task(std::forward<Func>(func), std::forward<Args>(args)...)));
+            TaskInfo<RET> info = add_task(std::forward<Func>(func), std::forward<Args>(args)...);
+            if (!info.valid())
+                return nullptr;
+            return std::unique_ptr<TaskInfo<RET>>(new TaskInfo<RET>(std::move(info)));
+        }
+
+        /**
+         * @brief Wrapper for add_task with submission options, return unique_ptr to TaskInfo
+         * @param options Dependencies and cost of the task (see TaskOptions)
+         * @param func Task function
+         * @param Arguments of the task (variadic)
+         * @return std::unique_ptr<TaskInfo<RET>>, where RET - return type of func
+         * nullptr if the task is rejected by admission control
+         */
+        template <typename Func, typename... Args, typename RET = result_of_t<Func(Args...)>>
+        auto add_task_uptr(const TaskOptions &options, Func &&func, Args &&...args) -> std::unique_ptr<TaskInfo<RET>>
+        {
+            TaskInfo<RET> info = add_task(options, std::forward<Func>(func), std::forward<Args>(args)...);
+            if (!info.valid())
+                return nullptr;
+            return std::unique_ptr<TaskInfo<RET>>(new TaskInfo<RET>(std::move(info)));
+        }
+
+        /**
+         * @brief Sets limits of admission control
+         * Tasks blocked in add_task are re-checked against the new limits
+         * @param limits Limits and submission policy (see QueueLimits)
+         */
+        void set_limits(const QueueLimits &limits);
+
+        /**
+         * @brief Releases projected result memory of finished tasks (see QueueLimits::max_bytes)
+         * Should be called by the owner when it drops results
+         * @param bytes Sum of TaskOptions::cost_bytes of dropped tasks
+         */
+        void release_bytes(size_t bytes);
+
+        /**
+         * @brief Creates resource group with its own sub-queue and concurrency limit
+         * Every client (see add_client) has its own sub-queue in the group, workers pick the next group
+         * of the client round-robin, skipping groups that run max_running tasks already
+         * @param name Name of the group, existing group with the same name is updated
+         * @param max_running Maximum number of tasks of the group executed at once (0 - unlimited)
+         * @return Group index for TaskOptions::group
+         */
+        size_t add_group(const std::string &name, size_t max_running = 0);
+
+        /**
+         * @brief Changes concurrency limit of the group
+         * @param group Group index (see add_group), the default group is always unlimited
+         * @param max_running Maximum number of tasks of the group executed at once (0 - unlimited)
+         * @return Success (true) or failure (false)
+         */
+        bool set_group_limit(size_t group, size_t max_running);
+
+        /**
+         * @brief Sets completion queue for all tracked tasks of the pool, in addition to TaskOptions::completion
+         * Only tasks that finish or are removed after the call are reported
+         * @param queue Completion queue (nullptr - detach)
+         */
+        void set_completion_queue(std::shared_ptr<CompletionQueue> queue);
+
+        /**
+         * @brief Creates submitting client with its own queues, so a flood of one client does not starve others
+         * Workers serve clients by weighted deficit round robin: a client takes up to weight tasks
+         * (or time slices of resumable tasks) in a row, then the next client with ready tasks is served.
+         * Group limits apply to tasks of all clients
+         * @param name Name of the client, existing client with the same name is updated
+         * @param weight Relative share of workers (at least 1)
+         * @return Client index for TaskOptions::client
+         */
+        size_t add_client(const std::string &name, size_t weight = 1);
+
+        /**
+         * @brief Changes weight of the client
+         * @param client Client index (see add_client), 0 - default client
+         * @param weight Relative share of workers (at least 1)
+         * @return Success (true) or failure (false)
+         */
+        bool set_client_weight(size_t client, size_t weight);
+
+        /**
+         * @brief Returns statistics of the client
+         * @param client Client index (see add_client), 0 - default client
+         * @param stats Statistics (output)
+         * @return Success (true) or failure (false)
+         */
+        bool client_stats(size_t client, ClientStats &stats);
+
+        /**
+         * @brief Returns number of failed CPU pinnings and memory bindings of workers (see StartOptions)
+         * Workers are placed asynchronously, the value is final once all of them have started
+         * @returns Number of failures since the last start
+        */
+        inline size_t num_placement_failures() const
+        {
+            return m_placement_failures;
         }
 
+        /**
+         * @brief Returns number of submissions rejected by admission control
+         * @returns Number of rejected tasks
+        */
+        inline size_t num_rejected() const
+        {
+            return m_rejected;
+        }
+
+        /**
+         * @brief Adds untracked job to the queue
+         * The job has no TaskInfo, produces no events and is not counted in num_finished
+         * Useful for internal work such as resuming coroutines, bypasses admission control
+         * @param func Job function
+         * @param deps Tasks of this pool that have to be completed first
+         */
+        void post(std::function<void()> func, const std::vector<const ITaskInfo *> &deps = {});
+
+#if defined(__cpp_impl_coroutine)
+        /**
+         * @brief Awaitable that resumes the awaiting coroutine on a worker of the pool
+         */
+        struct ScheduleAwaiter
+        {
+            ThreadPool &pool;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                pool.post([handle]
+                          { handle.resume(); });
+            }
+            void await_resume() const noexcept {}
+        };
+
+        /**
+         * @brief Moves coroutine to the pool: co_await pool.schedule()
+         * @return Awaitable object
+         */
+        ScheduleAwaiter schedule() { return ScheduleAwaiter{*this}; }
+#endif
+
         /**
          * @brief Sets callback for receiving thread pool events
          * @param func Callback function
@@ -115,6 +815,16 @@ namespace TP
             mEvent.start(std::forward<Func>(func));
         }
 
+        /**
+         * @brief Reserves unique task index for a task that is not executed by the pool
+         * (for example a task restored from snapshot)
+         * @return Task index
+        */
+        inline size_t reserve_idx()
+        {
+            return m_last_idx++;
+        }
+
         /**
          * @brief Returns number of finished tasks
          * @returns Number of finished tasks
@@ -125,34 +835,217 @@ namespace TP
         }
 
         /**
-         * @brief Destructor, just calls the stop method
+         * @brief Returns number of started but not finished tasks (running, paused or waiting for the next time slice)
+         * A finishing task is not counted anywhere for a moment, it never counts twice
+         * @returns Number of tasks in process
+        */
+        inline size_t num_in_process() const
+        {
+            return m_in_process;
+        }
+
+        /**
+         * @brief Returns index of the task executed by the calling thread
+         * Lets a task identify itself, its index is known only after submission
+         * @return Task index or kNoTask if the calling thread is not executing a task of a pool
+        */
+        static size_t current_task_id();
+
+        /**
+         * @brief Destructor, stops the timers and calls the stop method
         */
         inline ~ThreadPool()
         {
+            m_timers.stop();
             stop();
         }
 
     private:
+        /**
+         * @brief Implementations of remove_tasks, pause_tasks and resume_tasks for any set of indices
+         * Set should provide count, erase, size and iteration over indices
+         * keep_started - do not remove started resumable tasks (paused or waiting for the next slice)
+         */
+        template <typename Set>
+        void remove_tasks_impl(Set &idxs, bool keep_started = false);
+        template <typename Set>
+        void pause_tasks_impl(const Set &idxs);
+        template <typename Set>
+        void resume_tasks_impl(const Set &idxs);
+
+        /**
+         * @brief Waits for new tasks without parking according to the idle strategy
+         */
+        void spin_wait();
+
+        /**
+         * @brief Finds the client to be served (see add_client) and its group to take a task from
+         * m_queue_mtx should be locked by the caller
+         * @param client Found client index
+         * @param group Found group index
+         * @return Found (true) or not (false)
+         */
+        bool next_task(size_t &client, size_t &group) const;
+
+        /**
+         * @brief Finds the next group of the client (round-robin) that has queued tasks and is below its limit
+         * m_queue_mtx should be locked by the caller
+         * @param client Client
+         * @param group Found group index
+         * @return Found (true) or not (false)
+         */
+        bool next_group(const Client &client, size_t &group) const;
+
+        /**
+         * @brief Returns queue of the client and group of the task, creates it if needed
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         */
+        TaskQueue &queue_of(const QueueElement &element);
+
+        /**
+         * @brief Marks task as no longer executed by a worker, wakes up a worker if its group has been at the limit
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         */
+        void finish_running(const QueueElement &element);
+
+        /**
+         * @brief Admission control, waits or rejects according to QueueLimits
+         * @param lock Lock of m_queue_mtx
+         * @param cost Projected memory of the result
+         * @return Admitted (true) or rejected (false)
+         */
+        bool admit(std::unique_lock<std::mutex> &lock, size_t cost);
+
+        /**
+         * @brief Releases admission slot of the task that started or has been removed
+         * Removed task that has been started already is not counted in num_in_process anymore
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         * @param release_cost Release projected memory of the result as well
+         */
+        void release_admission(const QueueElement &element, bool release_cost);
+
+        /**
+         * @brief Pushes index of the finished or removed task into completion queues
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         */
+        void report_completion(const QueueElement &element);
+
+        /**
+         * @brief Puts task into the queue or into waiting list if it has unfinished dependencies
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         * @param deps Dependencies of the task
+         */
+        void enqueue(QueueElement &&element, const std::vector<const ITaskInfo *> &deps);
+
+        /**
+         * @brief Puts task into the queue keeping it sorted by index and wakes up a worker
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         */
+        void push_ready(QueueElement &&element);
+
+        /**
+         * @brief Puts partially executed resumable task to the back of the queue (or aside if it is paused)
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         */
+        void requeue(QueueElement &&element);
+
+        /**
+         * @brief Puts task aside and schedules its timer, the task is queued by release_delayed
+         * m_queue_mtx should be locked by the caller
+         * @param element Task
+         * @param delay Delay after which the task is queued
+         */
+        void schedule_delayed(QueueElement &&element, std::chrono::milliseconds delay);
+
+        /**
+         * @brief Queues delayed task, called by its timer (does nothing if the task has been removed)
+         * @param idx Task index
+         */
+        void release_delayed(size_t idx);
+
+        /**
+         * @brief Releases tasks that were waiting for the given task
+         * m_queue_mtx should be locked by the caller
+         * @param idx Index of finished task
+         */
+        void release_dependents(size_t idx);
+
         // Threads container
         std::vector<std::thread> m_threads;
 
         // Thread pool state flag (active or not)
         std::atomic<bool> m_active = {false};
 
+        // Options the pool has been started with
+        StartOptions m_options;
+
+        // Workers that failed to apply m_options.affinity or m_options.bind_memory
+        std::atomic<size_t> m_placement_failures = {0};
+
+        // Number of workers spinning in spin_wait
+        std::atomic<size_t> m_spinning = {0};
+
+        // Total length of task queues, readable without locking the queue
+        std::atomic<size_t> m_queued = {0};
+
         // Atomic variable for keeping track of new tasks indices
         std::atomic<size_t> m_last_idx = {0};
 
         // Atomic variable for keeping track of finished tasks
         std::atomic<size_t> m_finished = {0};
 
+        // Started tracked tasks that are not finished or removed yet
+        std::atomic<size_t> m_in_process = {0};
+
         // Mutex for reading&writing to queue by different threads
         std::mutex m_queue_mtx;
 
         // Conditional variable for notifying thread that a queue is not empty
         std::condition_variable m_queue_cv;
 
-        // Tasks queue
-        std::deque<QueueElement> m_tasks;
+        // Resource groups, m_groups[0] - default group
+        std::deque<Group> m_groups; // deque: groups are not relocated when added
+
+        // Submitting clients, m_clients[0] - default client
+        std::deque<Client> m_clients; // deque: clients are not relocated when added
+
+        // Client to be served by the next worker (weighted deficit round robin)
+        size_t m_next_client = 0;
+
+        // Admission control
+        QueueLimits m_limits;
+        size_t m_admitted_tasks = 0;
+        size_t m_admitted_bytes = 0;
+        std::atomic<size_t> m_rejected = {0};
+        std::condition_variable m_space_cv;
+
+        // Paused tasks (task index -> task) and indices of tasks to be paused
+        // Requests are kept as intervals, pausing a selection of all tasks costs the same as pausing one
+        std::unordered_map<size_t, QueueElement> m_paused;
+        SelectionSet m_pause_requested;
+
+        // Tasks with unfinished dependencies (task index -> task)
+        std::unordered_map<size_t, WaitingElement> m_waiting;
+
+        // Dependency graph (task index -> indices of waiting tasks that depend on it)
+        std::unordered_map<size_t, std::vector<size_t>> m_dependents;
+
+        // Completion queue of all tracked tasks (see set_completion_queue)
+        std::shared_ptr<CompletionQueue> m_completion;
+
+        // Tasks waiting for their timers (task index -> task), guarded by m_queue_mtx
+        std::unordered_map<size_t, DelayedElement> m_delayed;
+
+        // Timer thread of delayed and periodic tasks, started by the first timer
+        // Lock order: m_queue_mtx, then the wheel (timer actions are called without the wheel lock)
+        TimerWheel m_timers;
 
         // Event for callbacks
         AsyncEvent<size_t, bool> mEvent;
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace TP
+{
+    /**
+     * @brief Hierarchical timer wheel driven by one thread
+     * Level 0 has 256 slots of one tick, every next level has 64 slots covering the whole previous level each
+     * (5 levels, about 49 days with 1 ms ticks, longer delays are clamped).
+     * Timers of a higher level are moved down when the lower level wraps, so inserting and cancelling
+     * a timer is O(1) regardless of the number of pending timers.
+     * The thread sleeps till the next non-empty slot of level 0 (or till the wrap), not every tick.
+     *
+     * Actions are executed by the timer thread without holding the wheel lock, they should be short
+     * (e.g. put a task into the pool) and could schedule and cancel timers.
+     * Timers could be scheduled before start, they fire after it.
+     */
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Constructor
+         * @param resolution Duration of one tick
+         */
+        explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1));
+
+        /**
+         * @brief Destructor, just calls the stop method
+         */
+        ~TimerWheel();
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+        /**
+         * @brief Starts the timer thread
+         * @return Success (true) or failure (false, already started)
+         */
+        bool start();
+
+        /**
+         * @brief Stops the timer thread, pending timers are dropped without calling their actions
+         * @return Success (true) or failure (false, not started)
+         */
+        bool stop();
+
+        /**
+         * @brief Schedules action
+         * @param delay Delay of the first call (rounded up to ticks)
+         * @param period Period of the next calls, zero - call once
+         * @param action Function to call
+         * @return Timer id (never 0)
+         */
+        uint64_t schedule(Clock::duration delay, Clock::duration period, std::function<void()> action);
+
+        /**
+         * @brief Cancels timer, action that is being called right now is not interrupted
+         * @param timer_id Timer id
+         * @return Success (true) or failure (false, timer has fired already or does not exist)
+         */
+        bool cancel(uint64_t timer_id);
+
+        /**
+         * @brief Returns number of pending timers
+         */
+        size_t size() const;
+
+    private:
+        struct Slot;
+
+        static const int kLevel0Bits = 8;
+        static const int kLevelBits = 6;
+        static const int kNumLevels = 5;
+        static const uint64_t kLevel0Size = uint64_t(1) << kLevel0Bits;
+        static const uint64_t kLevelSize = uint64_t(1) << kLevelBits;
+        static const uint64_t kMaxDelay = (uint64_t(1) << (kLevel0Bits + (kNumLevels - 1) * kLevelBits)) - 1;
+
+        /**
+         * @brief Pending timer, linked into a slot
+         */
+        struct Timer
+        {
+            uint64_t id;
+            uint64_t expires;  // tick
+            uint64_t period;   // ticks, 0 - one-shot
+            std::function<void()> action;
+            Slot *slot = nullptr;
+            Timer *prev = nullptr;
+            Timer *next = nullptr;
+        };
+
+        /**
+         * @brief Slot of the wheel: intrusive doubly linked list of timers
+         */
+        struct Slot
+        {
+            Timer *head = nullptr;
+        };
+
+        /**
+         * @brief Timer thread
+         */
+        void run();
+
+        /**
+         * @brief Links timer into its slot, m_mtx should be locked
+         */
+        void link(Timer *timer);
+
+        /**
+         * @brief Unlinks timer from its slot, m_mtx should be locked
+         */
+        void unlink(Timer *timer);
+
+        /**
+         * @brief Moves timers of the slot to lower levels, m_mtx should be locked
+         * @return Index of the slot
+         */
+        uint64_t cascade(int level);
+
+        /**
+         * @brief Returns tick when the thread should wake up, m_mtx should be locked
+         */
+        uint64_t next_wakeup() const;
+
+        /**
+         * @brief Returns current tick
+         */
+        uint64_t now() const;
+
+        Clock::duration m_resolution;
+        Clock::time_point m_origin;
+
+        mutable std::mutex m_mtx;
+        std::condition_variable m_cv;
+        std::thread m_thread;
+        bool m_active = false;
+
+        // Next tick to process
+        uint64_t m_tick = 0;
+
+        // Tick the thread sleeps till (wakes up earlier for new timers only)
+        uint64_t m_wakeup = UINT64_MAX;
+
+        // Level 0 uses first kLevel0Size slots
+        Slot m_slots[kNumLevels][kLevel0Size];
+
+        // Pending timers by id, nodes of unordered_map keep their addresses
+        std::unordered_map<uint64_t, Timer> m_timers;
+        uint64_t m_last_id = 0;
+    };
+}
@@ -9,6 +9,17 @@ Item {
     property int numTotal: 0
     property int numSelected: 0
     property int numFinished: 0
+    property int numRejected: 0
+    property int numInQueue: 0
+    property int numInProcess: 0
+
+    // Task types for the type filter (see TaskModel.taskTypes)
+    property var taskTypes: []
+
+    // Filter and sort key of the task list (-1 - any, see TaskFilterModel)
+    readonly property int statusFilter: statusSelector.currentIndex - 1
+    readonly property int typeFilter: typeCheckBox.checked ? typeSelector.currentIndex : -1
+    readonly property int sortKey: sortSelector.currentIndex
 
     // Properties for thread selector
     property int threadSelectorVal: 10
@@ -24,6 +35,10 @@ Item {
     // Signal for "Remove selected" button
     signal removeTasks
 
+    // Signals for "Pause selected" and "Resume selected" buttons
+    signal pauseTasks
+    signal resumeTasks
+
     Rectangle { color: "silver"; height: parent.height; anchors.right: parent.right; width: 1; }
     Column {
         anchors.fill: parent
@@ -64,6 +79,22 @@ Item {
             onClicked: removeTasks()
         }
 
+        // Buttons to pause and resume selected tasks
+        // Should be enabled only if at least one task is selected
+        Button {
+            text: qsTr("Pause selected")
+            width: parent.width
+            enabled: (root.numSelected != 0)
+            onClicked: pauseTasks()
+        }
+
+        Button {
+            text: qsTr("Resume selected")
+            width: parent.width
+            enabled: (root.numSelected != 0)
+            onClicked: resumeTasks()
+        }
+
         // Just label
         Text {
             text: qsTr("Number of threads")
@@ -155,5 +186,46 @@ Item {
                 visible: numTotal != 0
             }
         }
+
+        // Number of tasks in every status
+        Text {
+            text: qsTr("In queue: %1\nIn process: %2").arg(root.numInQueue).arg(root.numInProcess)
+            visible: root.numTotal != 0
+        }
+
+        // Filter and sort key of the task list
+        Text {
+            text: qsTr("Show")
+        }
+        ComboBox {
+            id: statusSelector
+            width: parent.width
+            model: [qsTr("Any status"), qsTr("In queue"), qsTr("In process"), qsTr("Completed")]
+        }
+        Row {
+            width: parent.width
+            CheckBox {
+                id: typeCheckBox
+                height: typeSelector.height
+            }
+            ComboBox {
+                id: typeSelector
+                width: parent.width - typeCheckBox.width
+                enabled: typeCheckBox.checked
+                model: root.taskTypes
+            }
+        }
+        ComboBox {
+            id: sortSelector
+            width: parent.width
+            model: [qsTr("Sort by id"), qsTr("Sort by type"), qsTr("Sort by argument")]
+        }
+
+        // Tasks that did not fit into the pool limits
+        Text {
+            text: qsTr("Rejected (pool is full): %1").arg(root.numRejected)
+            color: "red"
+            visible: root.numRejected != 0
+        }
     }
 }
\ No newline at end of file
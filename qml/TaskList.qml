@@ -159,9 +159,6 @@ ListView {
             width: parent.width
             height: 1
         }
-        Component.onCompleted: {
-            root.model.updateIdMap(index);
-        }
     }
 
     // Clipboard hack
@@ -8,9 +8,29 @@ ApplicationWindow {
     visible: true
     title: qsTr("Thread Pool")
 
+    // Keep tasks and results between runs
+    onClosing: taskModel.saveSnapshot()
+
     // Model for taskList
     TaskModel {
         id: taskModel
+        Component.onCompleted: {
+            // Worker processes are started first, so restored tasks are executed there as well
+            if (workerProcesses > 0)
+                startProcesses(workerProcesses);
+            if (!setPlacement(threadPlacement, bindMemory))
+                console.warn("Unknown placement policy:", threadPlacement);
+            loadSnapshot();
+        }
+    }
+
+    // Filtered and sorted view of taskModel
+    TaskFilterModel {
+        id: taskFilterModel
+        sourceModel: taskModel
+        statusFilter: sidebar.statusFilter
+        typeFilter: sidebar.typeFilter
+        sortKey: sidebar.sortKey
     }
 
     // Popup window for task creation
@@ -25,7 +45,7 @@ ApplicationWindow {
         anchors.left: sidebar.right
         anchors.right: parent.right
         height: parent.height
-        model: taskModel
+        model: taskFilterModel
     }
 
     // Sidebar with controls
@@ -37,6 +57,10 @@ ApplicationWindow {
         numSelected: taskModel.numSelected
         numFinished: taskModel.numFinished
         numTotal: taskModel.numTotal
+        numRejected: taskModel.numRejected
+        numInQueue: taskModel.numInQueue
+        numInProcess: taskModel.numInProcess
+        taskTypes: taskModel.taskTypes
 
         onAddTasks: taskCreator.open()
         
@@ -45,6 +69,10 @@ ApplicationWindow {
             taskList.resetCheckboxSelectAll();
         }
 
+        onPauseTasks: taskModel.pauseTasks()
+
+        onResumeTasks: taskModel.resumeTasks()
+
         onThreadPoolActiveChanged: {
             if (threadPoolActive) {
                 taskModel.startPool(threadSelectorVal);
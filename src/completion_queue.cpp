@@ -0,0 +1,115 @@
+#include "completion_queue.hpp"
+
+#include <algorithm>
+
+namespace TP
+{
+    constexpr std::chrono::milliseconds CompletionQueue::kInfinite;
+
+    template <typename Pred>
+    bool CompletionQueue::wait(std::unique_lock<std::mutex> &lock, std::chrono::milliseconds timeout, Pred pred)
+    {
+        // Deadline of the infinite timeout would overflow
+        if (timeout == kInfinite)
+        {
+            m_cv.wait(lock, pred);
+            return true;
+        }
+        return m_cv.wait_for(lock, timeout, pred);
+    }
+
+    void CompletionQueue::push(size_t idx)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_completed.push_back(Entry{++m_last_seq, idx});
+        }
+        m_cv.notify_all();
+    }
+
+    std::vector<size_t> CompletionQueue::poll_completed(size_t max_batch)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return take(max_batch);
+    }
+
+    std::vector<size_t> CompletionQueue::wait_completed(std::chrono::milliseconds timeout, size_t max_batch)
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (!wait(lock, timeout, [this]
+                  { return !m_completed.empty(); }))
+            return std::vector<size_t>();
+        return take(max_batch);
+    }
+
+    bool CompletionQueue::wait_all(std::unordered_set<size_t> &idxs, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        uint64_t seq = 0;
+        std::vector<size_t> taken;
+        return wait(lock, timeout, [this, &idxs, &seq, &taken]
+                    {
+            taken.clear();
+            take_matching(idxs, seq, SIZE_MAX, taken);
+            for (size_t idx : taken)
+            {
+                idxs.erase(idx);
+            }
+            return idxs.empty(); });
+    }
+
+    bool CompletionQueue::wait_any(const std::unordered_set<size_t> &idxs, size_t &idx, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        uint64_t seq = 0;
+        std::vector<size_t> taken;
+        if (!wait(lock, timeout, [this, &idxs, &seq, &taken]
+                  {
+            take_matching(idxs, seq, 1, taken);
+            return !taken.empty(); }))
+            return false;
+
+        idx = taken.front();
+        return true;
+    }
+
+    size_t CompletionQueue::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_completed.size();
+    }
+
+    void CompletionQueue::take_matching(const std::unordered_set<size_t> &idxs, uint64_t &seq, size_t max_count, std::vector<size_t> &taken)
+    {
+        // Skip entries checked already (binary search, entries are ordered by seq)
+        auto it = std::upper_bound(m_completed.begin(), m_completed.end(), seq,
+                                   [](uint64_t target_seq, const Entry &entry)
+                                   { return target_seq < entry.seq; });
+
+        // Take matching entries keeping order of the rest
+        auto out = it;
+        for (; it != m_completed.end() && taken.size() < max_count; it++)
+        {
+            seq = it->seq;
+            if (idxs.count(it->idx))
+                taken.push_back(it->idx);
+            else
+                *out++ = *it;
+        }
+        if (out != it)
+            m_completed.erase(std::move(it, m_completed.end(), out), m_completed.end());
+    }
+
+    std::vector<size_t> CompletionQueue::take(size_t max_batch)
+    {
+        size_t n = std::min(max_batch, m_completed.size());
+        std::vector<size_t> batch;
+        batch.reserve(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            batch.push_back(m_completed[i].idx);
+        }
+        m_completed.erase(m_completed.begin(), m_completed.begin() + n);
+        return batch;
+    }
+}
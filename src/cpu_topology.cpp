@@ -0,0 +1,188 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace TP
+{
+    namespace
+    {
+        // Value of MPOL_PREFERRED from linux/mempolicy.h (avoids dependency on libnuma)
+        const int kMpolPreferred = 1;
+
+        // Parses list in format "0-3,8,10-11"
+        std::vector<int> parse_cpu_list(const std::string &list)
+        {
+            std::vector<int> cpus;
+            std::stringstream ss(list);
+            std::string range;
+            while (std::getline(ss, range, ','))
+            {
+                if (range.empty())
+                    continue;
+
+                size_t dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        // Keeps CPUs the process is allowed to run on (cgroup cpusets, taskset)
+        void filter_allowed(std::vector<int> &cpus, const cpu_set_t &allowed)
+        {
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&allowed](int cpu)
+                                      { return cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); }),
+                       cpus.end());
+        }
+
+        // Reads the first line of the file
+        std::string read_line(const std::string &path)
+        {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+    }
+
+    CpuTopology CpuTopology::detect()
+    {
+        CpuTopology topology;
+
+        // CPUs outside of the affinity mask of the process can not be pinned to
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool restricted = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        // Collect node indices from sysfs
+        std::vector<int> node_ids;
+        if (DIR *dir = opendir("/sys/devices/system/node"))
+        {
+            while (dirent *entry = readdir(dir))
+            {
+                int node = 0;
+                if (std::sscanf(entry->d_name, "node%d", &node) == 1)
+                    node_ids.push_back(node);
+            }
+            closedir(dir);
+        }
+        std::sort(node_ids.begin(), node_ids.end());
+
+        for (int node : node_ids)
+        {
+            std::vector<int> cpus = parse_cpu_list(
+                read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+            if (restricted)
+                filter_allowed(cpus, allowed);
+            if (!cpus.empty())
+            {
+                topology.m_node_ids.push_back(node);
+                topology.m_nodes.push_back(std::move(cpus));
+            }
+        }
+
+        // Fallback: one node with all allowed online CPUs
+        if (topology.m_nodes.empty())
+        {
+            std::vector<int> cpus = parse_cpu_list(read_line("/sys/devices/system/cpu/online"));
+            if (restricted)
+                filter_allowed(cpus, allowed);
+            if (cpus.empty())
+            {
+                for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++)
+                {
+                    cpus.push_back(i);
+                }
+            }
+            topology.m_node_ids.push_back(0);
+            topology.m_nodes.push_back(std::move(cpus));
+        }
+
+        return topology;
+    }
+
+    std::vector<int> CpuTopology::placement(size_t num_threads, AffinityPolicy policy) const
+    {
+        std::vector<int> cpus(num_threads, -1);
+        if (policy == AffinityPolicy::None)
+            return cpus;
+
+        // Order CPUs according to the policy
+        std::vector<int> order;
+        if (policy == AffinityPolicy::Compact)
+        {
+            for (const auto &node : m_nodes)
+            {
+                order.insert(order.end(), node.begin(), node.end());
+            }
+        }
+        else
+        {
+            size_t max_node_size = 0;
+            for (const auto &node : m_nodes)
+            {
+                max_node_size = std::max(max_node_size, node.size());
+            }
+            for (size_t i = 0; i < max_node_size; i++)
+            {
+                for (const auto &node : m_nodes)
+                {
+                    if (i < node.size())
+                        order.push_back(node[i]);
+                }
+            }
+        }
+
+        // Oversubscribed threads wrap around
+        for (size_t i = 0; i < num_threads && !order.empty(); i++)
+        {
+            cpus[i] = order[i % order.size()];
+        }
+        return cpus;
+    }
+
+    int CpuTopology::node_of(int cpu) const
+    {
+        for (size_t node = 0; node < m_nodes.size(); node++)
+        {
+            if (std::find(m_nodes[node].begin(), m_nodes[node].end(), cpu) != m_nodes[node].end())
+                return m_node_ids[node];
+        }
+        return -1;
+    }
+
+    bool pin_current_thread(int cpu)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE)
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    bool bind_current_thread_memory(int node)
+    {
+        if (node < 0 || node >= static_cast<int>(8 * sizeof(unsigned long)))
+            return false;
+
+        unsigned long mask = 1UL << node;
+        return syscall(SYS_set_mempolicy, kMpolPreferred, &mask, 8 * sizeof(mask) + 1) == 0;
+    }
+}
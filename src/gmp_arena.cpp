@@ -0,0 +1,302 @@
+#include "gmp_arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <gmp.h>
+
+namespace TP
+{
+    namespace
+    {
+        // Size classes: powers of two from 64 bytes to 4 KiB (including header)
+        // Chunks are never returned to the system, so only small blocks are pooled. Larger blocks
+        // go to malloc/free, their allocation cost is small compared to arithmetic on so many limbs
+        const size_t kMinClassShift = 6;
+        const size_t kNumClasses = 7;
+        const size_t kMaxClassSize = size_t(1) << (kMinClassShift + kNumClasses - 1);
+
+        // Arena memory is requested from the system by chunks
+        const size_t kChunkSize = size_t(4) << 20;
+
+        struct Arena;
+
+        /**
+         * @brief Header in front of every block, keeps user memory 16 bytes aligned
+         */
+        struct alignas(16) BlockHeader
+        {
+            Arena *owner; // nullptr - large block allocated with malloc
+            size_t size;  // size class index or size of large block
+        };
+
+        /**
+         * @brief Free block, the link is stored in user memory
+         */
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        struct Arena
+        {
+            // Accessed only by the owner thread
+            FreeBlock *free_lists[kNumClasses] = {};
+            char *chunk_pos = nullptr;
+            char *chunk_end = nullptr;
+
+            // Blocks freed by other threads (lock-free stack, drained by the owner)
+            std::atomic<FreeBlock *> remote_free = {nullptr};
+        };
+
+        std::atomic<bool> g_installed = {false};
+
+        // Arenas of exited threads, waiting for a new owner
+        std::mutex g_orphans_mtx;
+        std::vector<Arena *> g_orphans;
+        std::atomic<size_t> g_num_arenas = {0};
+
+        /**
+         * @brief Owns arena of the thread, orphans it when the thread exits
+         */
+        struct ArenaHolder
+        {
+            Arena *arena = nullptr;
+
+            ~ArenaHolder();
+        };
+
+        thread_local ArenaHolder t_holder;
+        thread_local bool t_exited = false;
+
+        ArenaHolder::~ArenaHolder()
+        {
+            t_exited = true;
+            if (!arena)
+                return;
+
+            std::lock_guard<std::mutex> lock(g_orphans_mtx);
+            g_orphans.push_back(arena);
+            arena = nullptr;
+        }
+
+        /**
+         * @brief Returns arena of the calling thread (nullptr if the thread is exiting)
+         */
+        Arena *current_arena()
+        {
+            if (t_holder.arena || t_exited)
+                return t_holder.arena;
+
+            {
+                std::lock_guard<std::mutex> lock(g_orphans_mtx);
+                if (!g_orphans.empty())
+                {
+                    t_holder.arena = g_orphans.back();
+                    g_orphans.pop_back();
+                }
+            }
+            if (!t_holder.arena)
+            {
+                t_holder.arena = new Arena();
+                g_num_arenas++;
+            }
+            return t_holder.arena;
+        }
+
+        size_t class_of(size_t size)
+        {
+            size_t cls = 0;
+            while ((size_t(1) << (kMinClassShift + cls)) < size)
+                cls++;
+            return cls;
+        }
+
+        size_t class_size(size_t cls)
+        {
+            return size_t(1) << (kMinClassShift + cls);
+        }
+
+        void *user_ptr(BlockHeader *header)
+        {
+            return header + 1;
+        }
+
+        BlockHeader *header_of(void *ptr)
+        {
+            return static_cast<BlockHeader *>(ptr) - 1;
+        }
+
+        /**
+         * @brief Moves blocks freed by other threads into free lists of the arena
+         */
+        void drain_remote(Arena *arena)
+        {
+            FreeBlock *block = arena->remote_free.exchange(nullptr, std::memory_order_acquire);
+            while (block)
+            {
+                FreeBlock *next = block->next;
+                size_t cls = header_of(block)->size;
+                block->next = arena->free_lists[cls];
+                arena->free_lists[cls] = block;
+                block = next;
+            }
+        }
+
+        /**
+         * @brief Same behaviour as the default GMP allocator on failure
+         */
+        void out_of_memory()
+        {
+            std::fputs("GNU MP: Cannot allocate memory\n", stderr);
+            std::abort();
+        }
+
+        void *large_alloc(size_t size)
+        {
+            BlockHeader *header = static_cast<BlockHeader *>(std::malloc(sizeof(BlockHeader) + size));
+            if (!header)
+                return nullptr;
+            header->owner = nullptr;
+            header->size = size;
+            return user_ptr(header);
+        }
+
+        void *arena_alloc(size_t size)
+        {
+            size_t total = sizeof(BlockHeader) + size;
+            Arena *arena = (total <= kMaxClassSize) ? current_arena() : nullptr;
+            if (!arena)
+                return large_alloc(size);
+
+            size_t cls = class_of(total);
+            if (!arena->free_lists[cls])
+                drain_remote(arena);
+
+            BlockHeader *header;
+            if (FreeBlock *block = arena->free_lists[cls])
+            {
+                arena->free_lists[cls] = block->next;
+                header = header_of(block);
+            }
+            else
+            {
+                // Carve new block from the current chunk, the tail of an exhausted chunk is dropped
+                size_t block_size = class_size(cls);
+                if (static_cast<size_t>(arena->chunk_end - arena->chunk_pos) < block_size)
+                {
+                    char *chunk = static_cast<char *>(std::malloc(kChunkSize));
+                    if (!chunk)
+                        return large_alloc(size);
+                    arena->chunk_pos = chunk;
+                    arena->chunk_end = chunk + kChunkSize;
+                }
+                header = reinterpret_cast<BlockHeader *>(arena->chunk_pos);
+                arena->chunk_pos += block_size;
+            }
+
+            header->owner = arena;
+            header->size = cls;
+            return user_ptr(header);
+        }
+
+        void arena_free(void *ptr)
+        {
+            if (!ptr)
+                return;
+
+            BlockHeader *header = header_of(ptr);
+            Arena *owner = header->owner;
+            if (!owner)
+            {
+                std::free(header);
+                return;
+            }
+
+            FreeBlock *block = static_cast<FreeBlock *>(ptr);
+            if (owner == t_holder.arena)
+            {
+                block->next = owner->free_lists[header->size];
+                owner->free_lists[header->size] = block;
+                return;
+            }
+
+            // Block outlived its thread or migrated (e.g. result read by the GUI), give it back to the owner
+            FreeBlock *head = owner->remote_free.load(std::memory_order_relaxed);
+            do
+            {
+                block->next = head;
+            } while (!owner->remote_free.compare_exchange_weak(head, block, std::memory_order_release,
+                                                               std::memory_order_relaxed));
+        }
+
+        size_t block_capacity(BlockHeader *header)
+        {
+            return header->owner ? class_size(header->size) - sizeof(BlockHeader) : header->size;
+        }
+
+        void *gmp_alloc(size_t size)
+        {
+            void *ptr = arena_alloc(size);
+            if (!ptr)
+                out_of_memory();
+            return ptr;
+        }
+
+        void *gmp_realloc(void *ptr, size_t old_size, size_t new_size)
+        {
+            if (!ptr)
+                return gmp_alloc(new_size);
+
+            BlockHeader *header = header_of(ptr);
+
+            // Block is large enough already, blocks that shrink a lot are moved (or trimmed) to give memory back
+            size_t capacity = block_capacity(header);
+            if (new_size <= capacity && new_size > capacity / 4)
+                return ptr;
+
+            // Large to large, let the system move pages or trim the block
+            if (!header->owner && sizeof(BlockHeader) + new_size > kMaxClassSize)
+            {
+                BlockHeader *moved = static_cast<BlockHeader *>(std::realloc(header, sizeof(BlockHeader) + new_size));
+                if (!moved)
+                    out_of_memory();
+                moved->size = new_size;
+                return user_ptr(moved);
+            }
+
+            void *new_ptr = gmp_alloc(new_size);
+            std::memcpy(new_ptr, ptr, std::min(std::min(old_size, new_size), block_capacity(header)));
+            arena_free(ptr);
+            return new_ptr;
+        }
+
+        void gmp_free(void *ptr, size_t)
+        {
+            arena_free(ptr);
+        }
+    }
+
+    bool install_gmp_arena()
+    {
+        if (g_installed.exchange(true))
+            return false;
+
+        mp_set_memory_functions(gmp_alloc, gmp_realloc, gmp_free);
+        return true;
+    }
+
+    bool gmp_arena_installed()
+    {
+        return g_installed;
+    }
+
+    size_t gmp_arena_count()
+    {
+        return g_num_arenas;
+    }
+}
@@ -1,18 +1,48 @@
 #include "task_model.hpp"
+#include "task_filter_model.hpp"
+#include "process_backend.hpp"
+#include "gmp_arena.hpp"
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QObject>
 
 int main(int argc, char *argv[])
 {
+    // Worker processes (see TaskModel::startProcesses) run the same executable without GUI
+    TaskModel::registerRemoteTasks();
+    if (TP::ProcessBackend::is_worker(argc, argv))
+        return TP::ProcessBackend::worker_main(argc, argv);
+
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QApplication app(argc, argv);
 
+    // Number of worker processes for tasks (0 - tasks are executed by threads of this process)
+    QCommandLineParser parser;
+    QCommandLineOption processes_option("processes", "Execute tasks in <n> worker processes.", "n", "0");
+    // Thread-local arena allocator for GMP, installed before any number is created
+    QCommandLineOption arena_option("gmp-arena", "Allocate GMP numbers from thread-local arenas.");
+    // Placement of pool threads on CPU cores and NUMA nodes (see TP::StartOptions)
+    QCommandLineOption placement_option("placement", "Pin pool threads: none, compact or scatter.", "policy", "none");
+    QCommandLineOption membind_option("membind", "Allocate memory of pinned threads on their own NUMA node.");
+    parser.addHelpOption();
+    parser.addOption(processes_option);
+    parser.addOption(arena_option);
+    parser.addOption(placement_option);
+    parser.addOption(membind_option);
+    parser.process(app);
+    if (parser.isSet(arena_option))
+        TP::install_gmp_arena();
+
     qmlRegisterUncreatableMetaObject(TP::staticMetaObject, "TaskModel", 1, 0, "Task", "For Status ENUM");
     qmlRegisterType<TaskModel>("TaskModel", 1, 0, "TaskModel");
+    qmlRegisterType<TaskFilterModel>("TaskModel", 1, 0, "TaskFilterModel");
 
     QQmlApplicationEngine engine;
+    engine.rootContext()->setContextProperty("workerProcesses", parser.value(processes_option).toInt());
+    engine.rootContext()->setContextProperty("threadPlacement", parser.value(placement_option));
+    engine.rootContext()->setContextProperty("bindMemory", parser.isSet(membind_option));
     const QUrl url(QStringLiteral("qrc:/main.qml"));
     QObject::connect(&engine, &QQmlApplicationEngine::objectCreated,
                      &app, [url](QObject *obj, const QUrl &objUrl) {
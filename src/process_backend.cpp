@@ -0,0 +1,346 @@
+#include "process_backend.hpp"
+#include "snapshot.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace TP
+{
+    namespace
+    {
+        const char kWorkerFlag[] = "--tp-worker";
+
+        // Socket of the worker process has a fixed descriptor
+        const int kWorkerFd = 3;
+
+        struct Request
+        {
+            uint32_t id;
+            int32_t arg;
+        };
+
+        struct Response
+        {
+            uint8_t status;   // 0 - result limbs follow, 1 - error message follows
+            uint8_t negative; // sign of the result
+            uint8_t reserved[6];
+            uint64_t size; // number of limbs or length of error message
+        };
+
+        std::vector<std::pair<std::string, RemoteFunction>> &registry()
+        {
+            static std::vector<std::pair<std::string, RemoteFunction>> functions;
+            return functions;
+        }
+
+        bool read_all(int fd, void *data, size_t size)
+        {
+            char *ptr = static_cast<char *>(data);
+            while (size)
+            {
+                ssize_t n = ::read(fd, ptr, size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                ptr += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool write_all(int fd, const void *data, size_t size)
+        {
+            const char *ptr = static_cast<const char *>(data);
+            while (size)
+            {
+                // Do not die from SIGPIPE if the other side is gone
+                ssize_t n = ::send(fd, ptr, size, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                ptr += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool write_error(int fd, const std::string &message)
+        {
+            Response response = {};
+            response.status = 1;
+            response.size = message.size();
+            return write_all(fd, &response, sizeof(response)) && write_all(fd, message.data(), message.size());
+        }
+
+        bool write_result(int fd, const mpz_class &result)
+        {
+            std::vector<uint64_t> limbs = export_limbs(result);
+
+            Response response = {};
+            response.negative = sgn(result) < 0;
+            response.size = limbs.size();
+            return write_all(fd, &response, sizeof(response)) && write_all(fd, limbs.data(), limbs.size() * sizeof(uint64_t));
+        }
+    }
+
+    uint32_t ProcessBackend::register_function(const std::string &name, RemoteFunction func)
+    {
+        registry().emplace_back(name, func);
+        return registry().size() - 1;
+    }
+
+    bool ProcessBackend::find_function(const std::string &name, uint32_t &id)
+    {
+        const auto &functions = registry();
+        for (size_t i = 0; i < functions.size(); i++)
+        {
+            if (functions[i].first == name)
+            {
+                id = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ProcessBackend::is_worker(int argc, char *argv[])
+    {
+        return argc >= 2 && std::strcmp(argv[1], kWorkerFlag) == 0;
+    }
+
+    int ProcessBackend::worker_main(int argc, char *argv[])
+    {
+        // Limit address space, so runaway task kills only this process
+        size_t memory_limit = (argc >= 3) ? std::strtoull(argv[2], nullptr, 10) : 0;
+        if (memory_limit)
+        {
+            struct rlimit limit;
+            limit.rlim_cur = limit.rlim_max = memory_limit;
+            setrlimit(RLIMIT_AS, &limit);
+        }
+
+        const auto &functions = registry();
+        Request request;
+        while (read_all(kWorkerFd, &request, sizeof(request)))
+        {
+            bool ok = false;
+            if (request.id >= functions.size())
+            {
+                ok = write_error(kWorkerFd, "unknown function");
+            }
+            else
+            {
+                try
+                {
+                    ok = write_result(kWorkerFd, functions[request.id].second(request.arg));
+                }
+                catch (const std::exception &e)
+                {
+                    ok = write_error(kWorkerFd, e.what());
+                }
+            }
+
+            if (!ok)
+                return 1;
+        }
+
+        // Parent closed the socket
+        return 0;
+    }
+
+    ProcessBackend::~ProcessBackend()
+    {
+        stop();
+    }
+
+    bool ProcessBackend::start(size_t num_processes, const ProcessOptions &options)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_active || num_processes == 0)
+            return false;
+
+        m_options = options;
+        for (size_t i = 0; i < num_processes; i++)
+        {
+            Worker worker;
+            if (!spawn(worker))
+                break;
+            m_idle.push_back(worker);
+        }
+
+        m_num_workers = m_idle.size();
+        m_active = m_num_workers != 0;
+        return m_active;
+    }
+
+    bool ProcessBackend::stop()
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (!m_active)
+            return false;
+
+        // Reject new calls and wait for running ones
+        m_active = false;
+        m_cv.notify_all();
+        m_cv.wait(lock, [this]
+                  { return m_idle.size() == m_num_workers; });
+
+        // Workers exit when the socket is closed
+        for (auto &worker : m_idle)
+        {
+            terminate(worker, false);
+        }
+        m_idle.clear();
+        m_num_workers = 0;
+
+        return true;
+    }
+
+    mpz_class ProcessBackend::call(uint32_t id, int arg)
+    {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_cv.wait(lock, [this]
+                  { return !m_idle.empty() || !m_active || m_num_workers == 0; });
+        if (!m_active)
+            throw RemoteError("process backend is stopped");
+        if (m_idle.empty())
+            throw RemoteError("no worker processes");
+
+        Worker worker = m_idle.back();
+        m_idle.pop_back();
+        lock.unlock();
+
+        mpz_class result;
+        std::string error;
+        bool alive = transact(worker, id, arg, result, error);
+
+        // Replace crashed worker, the call fails anyway
+        bool respawned = false;
+        if (!alive)
+        {
+            terminate(worker, true);
+            respawned = spawn(worker);
+        }
+
+        lock.lock();
+        if (alive || respawned)
+            m_idle.push_back(worker);
+        else
+            m_num_workers--;
+        if (respawned)
+            m_num_respawned++;
+        lock.unlock();
+        m_cv.notify_all();
+
+        if (!alive)
+            throw RemoteError("worker process crashed");
+        if (!error.empty())
+            throw RemoteError(error);
+        return result;
+    }
+
+    size_t ProcessBackend::num_respawned() const
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_num_respawned;
+    }
+
+    bool ProcessBackend::spawn(Worker &worker)
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+            return false;
+
+        // dup2 onto itself would keep close-on-exec flag
+        if (fds[1] == kWorkerFd)
+        {
+            int fd = fcntl(fds[1], F_DUPFD_CLOEXEC, kWorkerFd + 1);
+            ::close(fds[1]);
+            fds[1] = fd;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], kWorkerFd);
+
+        // Same executable, main() should dispatch to worker_main
+        std::string memory_limit = std::to_string(m_options.memory_limit);
+        char exe[] = "/proc/self/exe";
+        char flag[sizeof(kWorkerFlag)];
+        std::memcpy(flag, kWorkerFlag, sizeof(kWorkerFlag));
+        char *argv[] = {exe, flag, &memory_limit[0], nullptr};
+
+        pid_t pid = -1;
+        int err = fds[1] >= 0 ? posix_spawn(&pid, exe, &actions, nullptr, argv, environ) : -1;
+        posix_spawn_file_actions_destroy(&actions);
+        if (fds[1] >= 0)
+            ::close(fds[1]);
+
+        if (err != 0)
+        {
+            ::close(fds[0]);
+            return false;
+        }
+
+        worker.pid = pid;
+        worker.fd = fds[0];
+        return true;
+    }
+
+    void ProcessBackend::terminate(Worker &worker, bool force)
+    {
+        if (force && worker.pid > 0)
+            kill(worker.pid, SIGKILL);
+        if (worker.fd >= 0)
+            ::close(worker.fd);
+        if (worker.pid > 0)
+        {
+            while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR)
+            {
+            }
+        }
+        worker = Worker();
+    }
+
+    bool ProcessBackend::transact(Worker &worker, uint32_t id, int arg, mpz_class &result, std::string &error)
+    {
+        Request request = {id, arg};
+        Response response;
+        if (!write_all(worker.fd, &request, sizeof(request)) ||
+            !read_all(worker.fd, &response, sizeof(response)))
+            return false;
+
+        if (response.status != 0)
+        {
+            error.resize(response.size);
+            if (!read_all(worker.fd, &error[0], error.size()))
+                return false;
+            if (error.empty())
+                error = "remote task failed";
+            return true;
+        }
+
+        std::vector<uint64_t> limbs(response.size);
+        if (!read_all(worker.fd, limbs.data(), limbs.size() * sizeof(uint64_t)))
+            return false;
+
+        mpz_import(result.get_mpz_t(), limbs.size(), -1, sizeof(uint64_t), 0, 0, limbs.data());
+        if (response.negative)
+            result = -result;
+        return true;
+    }
+}
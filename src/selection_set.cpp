@@ -0,0 +1,76 @@
+#include "selection_set.hpp"
+
+#include <algorithm>
+
+namespace TP
+{
+    void SelectionSet::insert_range(size_t first, size_t last)
+    {
+        if (first >= last)
+            return;
+
+        // Start from the interval that overlaps or touches first
+        auto it = m_intervals.upper_bound(first);
+        if (it != m_intervals.begin() && std::prev(it)->second >= first)
+            --it;
+
+        // Merge all overlapping and adjacent intervals
+        while (it != m_intervals.end() && it->first <= last)
+        {
+            first = std::min(first, it->first);
+            last = std::max(last, it->second);
+            m_size -= it->second - it->first;
+            it = m_intervals.erase(it);
+        }
+
+        m_intervals.emplace_hint(it, first, last);
+        m_size += last - first;
+    }
+
+    size_t SelectionSet::erase(size_t idx)
+    {
+        if (!count(idx))
+            return 0;
+        erase_range(idx, idx + 1);
+        return 1;
+    }
+
+    void SelectionSet::erase_range(size_t first, size_t last)
+    {
+        if (first >= last)
+            return;
+
+        auto it = m_intervals.upper_bound(first);
+        if (it != m_intervals.begin() && std::prev(it)->second > first)
+            --it;
+
+        // Cut all overlapping intervals, keeping parts outside of [first, last)
+        while (it != m_intervals.end() && it->first < last)
+        {
+            size_t begin = it->first;
+            size_t end = it->second;
+            m_size -= end - begin;
+            it = m_intervals.erase(it);
+
+            if (begin < first)
+            {
+                m_intervals.emplace_hint(it, begin, first);
+                m_size += first - begin;
+            }
+            if (end > last)
+            {
+                it = m_intervals.emplace_hint(it, last, end);
+                m_size += end - last;
+                break;
+            }
+        }
+    }
+
+    size_t SelectionSet::count(size_t idx) const
+    {
+        auto it = m_intervals.upper_bound(idx);
+        if (it == m_intervals.begin())
+            return 0;
+        return (--it)->second > idx;
+    }
+}
@@ -0,0 +1,192 @@
+#include "snapshot.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TP
+{
+    namespace
+    {
+        const char kMagic[8] = {'T', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+
+        // Flushes the directory entry of the file (e.g. after rename) to the disk
+        bool sync_parent_dir(const std::string &path)
+        {
+            size_t slash = path.rfind('/');
+            std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+            int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (fd < 0)
+                return false;
+
+            // Some file systems do not support syncing directories, nothing more can be done there
+            bool ok = fsync(fd) == 0 || errno == EINVAL;
+            ::close(fd);
+            return ok;
+        }
+    }
+
+    std::vector<uint64_t> export_limbs(const mpz_class &value)
+    {
+        // Export directly into the vector, GMP does not allocate its own buffer
+        std::vector<uint64_t> limbs((mpz_sizeinbase(value.get_mpz_t(), 2) + 63) / 64);
+        size_t size = 0;
+        mpz_export(limbs.data(), &size, -1, sizeof(uint64_t), 0, 0, value.get_mpz_t());
+        limbs.resize(size);
+        return limbs;
+    }
+
+    SnapshotWriter::SnapshotWriter(const std::string &path, size_t num_records) : m_path(path),
+                                                                                  m_tmp_path(path + ".tmp"),
+                                                                                  m_num_records(num_records)
+    {
+        m_records.reserve(num_records);
+        m_file = std::fopen(m_tmp_path.c_str(), "wb");
+
+        // Skip header and records, they are written by finish()
+        long data_begin = sizeof(SnapshotHeader) + num_records * sizeof(SnapshotRecord);
+        m_ok = m_file && std::fseek(m_file, data_begin, SEEK_SET) == 0;
+    }
+
+    SnapshotWriter::~SnapshotWriter()
+    {
+        if (m_file)
+        {
+            std::fclose(m_file);
+            std::remove(m_tmp_path.c_str());
+        }
+    }
+
+    void SnapshotWriter::add(SnapshotRecord record, const mpz_class *result)
+    {
+        if (!result)
+        {
+            add_raw(record, nullptr, 0, false);
+            return;
+        }
+
+        std::vector<uint64_t> limbs = export_limbs(*result);
+        add_raw(record, limbs.data(), limbs.size(), sgn(*result) < 0);
+    }
+
+    void SnapshotWriter::add_raw(SnapshotRecord record, const uint64_t *limbs, size_t size, bool negative)
+    {
+        if (m_records.size() == m_num_records)
+        {
+            m_ok = false;
+            return;
+        }
+
+        record.result_offset = m_data_size;
+        record.result_size = size;
+        record.negative = negative;
+        std::memset(record.reserved, 0, sizeof(record.reserved));
+        m_records.push_back(record);
+
+        if (size && m_ok)
+            m_ok = std::fwrite(limbs, sizeof(uint64_t), size, m_file) == size;
+        m_data_size += size;
+    }
+
+    bool SnapshotWriter::finish()
+    {
+        if (!m_file)
+            return false;
+
+        SnapshotHeader header;
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.num_records = m_records.size();
+        header.data_size = m_data_size;
+
+        m_ok = m_ok && m_records.size() == m_num_records &&
+               std::fseek(m_file, 0, SEEK_SET) == 0 &&
+               std::fwrite(&header, sizeof(header), 1, m_file) == 1 &&
+               std::fwrite(m_records.data(), sizeof(SnapshotRecord), m_records.size(), m_file) == m_records.size();
+
+        // Data has to reach the disk before rename, otherwise a crash could leave the new name with an empty file
+        m_ok = m_ok && std::fflush(m_file) == 0 && fsync(fileno(m_file)) == 0;
+        m_ok = (std::fclose(m_file) == 0) && m_ok;
+        m_file = nullptr;
+
+        // Replace old snapshot (mappings of the old file stay valid)
+        if (m_ok)
+            m_ok = std::rename(m_tmp_path.c_str(), m_path.c_str()) == 0;
+        if (!m_ok)
+        {
+            std::remove(m_tmp_path.c_str());
+            return false;
+        }
+
+        // Make the rename itself durable
+        m_ok = sync_parent_dir(m_path);
+        return m_ok;
+    }
+
+    std::shared_ptr<Snapshot> Snapshot::open(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader))
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        // Map the whole file, pages are loaded on first access
+        size_t map_size = st.st_size;
+        void *map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return nullptr;
+
+        std::shared_ptr<Snapshot> snapshot(new Snapshot());
+        snapshot->m_map = map;
+        snapshot->m_map_size = map_size;
+        snapshot->m_header = static_cast<const SnapshotHeader *>(map);
+
+        // Validate layout
+        const SnapshotHeader &header = *snapshot->m_header;
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+            header.num_records > (map_size - sizeof(SnapshotHeader)) / sizeof(SnapshotRecord))
+            return nullptr;
+
+        size_t data_begin = sizeof(SnapshotHeader) + header.num_records * sizeof(SnapshotRecord);
+        if (header.data_size > (map_size - data_begin) / sizeof(uint64_t))
+            return nullptr;
+
+        snapshot->m_records = reinterpret_cast<const SnapshotRecord *>(static_cast<const char *>(map) + sizeof(SnapshotHeader));
+        snapshot->m_data = reinterpret_cast<const uint64_t *>(static_cast<const char *>(map) + data_begin);
+
+        for (size_t i = 0; i < header.num_records; i++)
+        {
+            const SnapshotRecord &record = snapshot->m_records[i];
+            if (record.result_offset > header.data_size || record.result_size > header.data_size - record.result_offset)
+                return nullptr;
+        }
+
+        return snapshot;
+    }
+
+    Snapshot::~Snapshot()
+    {
+        if (m_map)
+            munmap(m_map, m_map_size);
+    }
+
+    mpz_class Snapshot::result(size_t i) const
+    {
+        const SnapshotRecord &record = m_records[i];
+        mpz_class result;
+        mpz_import(result.get_mpz_t(), record.result_size, -1, sizeof(uint64_t), 0, 0, m_data + record.result_offset);
+        if (record.negative)
+            result = -result;
+        return result;
+    }
+}
@@ -0,0 +1,413 @@
+#include "task_filter_model.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Larger batches of appended rows (or ranges of rows changing membership) are merged
+    // into the mapping at once (resets the view)
+    const int kMaxIncrementalInsert = 64;
+}
+
+TaskFilterModel::TaskFilterModel(QObject *parent) : QAbstractListModel(parent)
+{
+}
+
+int TaskFilterModel::rowCount(const QModelIndex &parent) const
+{
+    if (!m_source)
+        return 0;
+    return m_identity ? m_source->rowCount() : static_cast<int>(m_rows.size());
+}
+
+QVariant TaskFilterModel::data(const QModelIndex &index, int role) const
+{
+    int src_row = sourceRow(index.row());
+    if (!index.isValid() || src_row < 0)
+        return QVariant();
+    return m_source->data(m_source->index(src_row), role);
+}
+
+bool TaskFilterModel::setData(const QModelIndex &index, const QVariant &v, int role)
+{
+    // Source model emits dataChanged, it is mapped back to this model
+    int src_row = sourceRow(index.row());
+    if (!index.isValid() || src_row < 0)
+        return false;
+    return m_source->setData(m_source->index(src_row), v, role);
+}
+
+QHash<int, QByteArray> TaskFilterModel::roleNames() const
+{
+    return m_source ? m_source->roleNames() : QAbstractListModel::roleNames();
+}
+
+void TaskFilterModel::setSourceModel(TaskModel *source)
+{
+    if (m_source == source)
+        return;
+
+    beginResetModel();
+    if (m_source)
+        disconnect(m_source, nullptr, this, nullptr);
+    m_source = source;
+
+    if (m_source)
+    {
+        connect(m_source, &QAbstractItemModel::rowsAboutToBeInserted, this, &TaskFilterModel::onRowsAboutToBeInserted);
+        connect(m_source, &QAbstractItemModel::rowsInserted, this, &TaskFilterModel::onRowsInserted);
+        connect(m_source, &QAbstractItemModel::dataChanged, this, &TaskFilterModel::onDataChanged);
+        connect(m_source, &QAbstractItemModel::modelAboutToBeReset, this, &TaskFilterModel::onModelAboutToBeReset);
+        connect(m_source, &QAbstractItemModel::modelReset, this, &TaskFilterModel::onModelReset);
+
+        // TaskModel removes rows with reset, other removals are handled the same way
+        connect(m_source, &QAbstractItemModel::rowsAboutToBeRemoved, this, [this]
+                { onModelAboutToBeReset(); });
+        connect(m_source, &QAbstractItemModel::rowsRemoved, this, [this]
+                { onModelReset(); });
+    }
+
+    rebuild();
+    endResetModel();
+    emit sourceModelChanged();
+}
+
+void TaskFilterModel::setStatusFilter(int status)
+{
+    if (m_status_filter == status)
+        return;
+    m_status_filter = status;
+    reset();
+}
+
+void TaskFilterModel::setTypeFilter(int type)
+{
+    if (m_type_filter == type)
+        return;
+    m_type_filter = type;
+    reset();
+}
+
+void TaskFilterModel::setSortKey(SortKey key)
+{
+    if (m_sort_key == key)
+        return;
+    m_sort_key = key;
+    reset();
+}
+
+int TaskFilterModel::sourceRow(int row_idx) const
+{
+    if (row_idx < 0 || row_idx >= rowCount())
+        return -1;
+    return m_identity ? row_idx : m_rows[row_idx];
+}
+
+void TaskFilterModel::selectTasksAll(bool select)
+{
+    if (m_source)
+        m_source->selectTasksAll(select);
+}
+
+bool TaskFilterModel::isIdentity() const
+{
+    return m_status_filter < 0 && m_type_filter < 0 && m_sort_key == SortKey::Id;
+}
+
+bool TaskFilterModel::accepts(int src_row) const
+{
+    if (m_type_filter >= 0 && static_cast<int>(m_source->taskType(src_row)) != m_type_filter)
+        return false;
+    if (m_status_filter >= 0 && static_cast<int>(m_source->taskStatus(src_row)) != m_status_filter)
+        return false;
+    return true;
+}
+
+bool TaskFilterModel::lessThan(int src_a, int src_b) const
+{
+    // Type and argument of a row never change, the order of rows is stable
+    switch (m_sort_key)
+    {
+    case SortKey::Id:
+        break;
+    case SortKey::Type:
+        if (m_source->taskType(src_a) != m_source->taskType(src_b))
+            return m_source->taskType(src_a) < m_source->taskType(src_b);
+        break;
+    case SortKey::Arg:
+        if (m_source->taskArg(src_a) != m_source->taskArg(src_b))
+            return m_source->taskArg(src_a) < m_source->taskArg(src_b);
+        break;
+    }
+
+    // Rows of the source model are ordered by id
+    return src_a < src_b;
+}
+
+std::vector<int>::iterator TaskFilterModel::lowerBound(int src_row)
+{
+    return std::lower_bound(m_rows.begin(), m_rows.end(), src_row,
+                            [this](int a, int b)
+                            { return lessThan(a, b); });
+}
+
+void TaskFilterModel::rebuild()
+{
+    m_identity = isIdentity();
+    m_rows.clear();
+    if (!m_source || m_identity)
+        return;
+
+    int n = m_source->rowCount();
+    for (int i = 0; i < n; i++)
+    {
+        if (accepts(i))
+            m_rows.push_back(i);
+    }
+    if (m_sort_key != SortKey::Id)
+    {
+        std::sort(m_rows.begin(), m_rows.end(), [this](int a, int b)
+                  { return lessThan(a, b); });
+    }
+}
+
+void TaskFilterModel::reset()
+{
+    beginResetModel();
+    rebuild();
+    endResetModel();
+    emit filterChanged();
+}
+
+void TaskFilterModel::onRowsAboutToBeInserted(const QModelIndex &, int first, int last)
+{
+    if (m_identity)
+        beginInsertRows(QModelIndex(), first, last);
+}
+
+void TaskFilterModel::onRowsInserted(const QModelIndex &, int first, int last)
+{
+    if (m_identity)
+    {
+        endInsertRows();
+        return;
+    }
+
+    // Rows inserted in the middle shift the mapping, TaskModel only appends
+    if (last + 1 != m_source->rowCount())
+    {
+        beginResetModel();
+        rebuild();
+        endResetModel();
+        return;
+    }
+
+    std::vector<int> added;
+    for (int i = first; i <= last; i++)
+    {
+        if (accepts(i))
+            added.push_back(i);
+    }
+    if (added.empty())
+        return;
+
+    int size = m_rows.size();
+    if (m_sort_key == SortKey::Id)
+    {
+        // New rows have the largest ids
+        beginInsertRows(QModelIndex(), size, size + added.size() - 1);
+        m_rows.insert(m_rows.end(), added.begin(), added.end());
+        endInsertRows();
+        return;
+    }
+
+    auto less = [this](int a, int b)
+    { return lessThan(a, b); };
+    std::sort(added.begin(), added.end(), less);
+
+    if (static_cast<int>(added.size()) > kMaxIncrementalInsert)
+    {
+        // O(N) merge instead of O(N) moves for every row
+        beginResetModel();
+        m_rows.insert(m_rows.end(), added.begin(), added.end());
+        std::inplace_merge(m_rows.begin(), m_rows.begin() + size, m_rows.end(), less);
+        endResetModel();
+        return;
+    }
+
+    for (int src_row : added)
+    {
+        int pos = lowerBound(src_row) - m_rows.begin();
+        beginInsertRows(QModelIndex(), pos, pos);
+        m_rows.insert(m_rows.begin() + pos, src_row);
+        endInsertRows();
+    }
+}
+
+void TaskFilterModel::onDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right, const QVector<int> &roles)
+{
+    // Signal could be queued from the thread pool and outlive rows of the source model
+    int first = std::max(top_left.row(), 0);
+    int last = std::min(bottom_right.row(), m_source->rowCount() - 1);
+    if (first > last)
+        return;
+
+    if (m_identity)
+    {
+        emit dataChanged(index(first), index(last), roles);
+        return;
+    }
+
+    // Only status changes membership, other roles are mapped to rows of this model
+    bool membership = m_status_filter >= 0 && (roles.isEmpty() || roles.contains(TaskModel::StatusRole));
+    if (!membership)
+    {
+        if (m_rows.empty())
+            return;
+
+        // All rows of the source model (e.g. select all)
+        if (first == 0 && last == m_source->rowCount() - 1)
+        {
+            emit dataChanged(index(0), index(m_rows.size() - 1), roles);
+            return;
+        }
+
+        if (m_sort_key == SortKey::Id)
+        {
+            int begin = lowerBound(first) - m_rows.begin();
+            int end = lowerBound(last + 1) - m_rows.begin();
+            if (begin < end)
+                emit dataChanged(index(begin), index(end - 1), roles);
+            return;
+        }
+    }
+
+    // Sort changed rows into rows that stay (positions), leave (positions) and join the view (source rows)
+    std::vector<int> changed;
+    std::vector<int> removed;
+    std::vector<int> added;
+    for (int src_row = first; src_row <= last; src_row++)
+    {
+        auto it = lowerBound(src_row);
+        int pos = it - m_rows.begin();
+        bool present = (it != m_rows.end() && *it == src_row);
+        bool accepted = membership ? accepts(src_row) : present;
+
+        if (present && accepted)
+            changed.push_back(pos);
+        else if (present)
+            removed.push_back(pos);
+        else if (accepted)
+            added.push_back(src_row);
+    }
+
+    // Rows that stay are updated before positions shift
+    std::sort(changed.begin(), changed.end());
+    forEachRange(changed, [this, &roles](int begin, int end)
+                 { emit dataChanged(index(begin), index(end - 1), roles); });
+    if (removed.empty() && added.empty())
+        return;
+
+    auto less = [this](int a, int b)
+    { return lessThan(a, b); };
+    std::sort(removed.begin(), removed.end());
+    std::sort(added.begin(), added.end(), less);
+
+    // Positions of added rows in the view without removed rows
+    std::vector<int> insert_pos;
+    insert_pos.reserve(added.size());
+    for (int src_row : added)
+    {
+        int pos = lowerBound(src_row) - m_rows.begin();
+        insert_pos.push_back(pos - (std::lower_bound(removed.begin(), removed.end(), pos) - removed.begin()));
+    }
+
+    // Every range is a signal pair and a move of the tail, many of them are replaced with a single reset
+    int num_ranges = 0;
+    forEachRange(removed, [&num_ranges](int, int)
+                 { num_ranges++; });
+    for (size_t i = 0; i < insert_pos.size(); i++)
+    {
+        num_ranges += (i == 0 || insert_pos[i] != insert_pos[i - 1]);
+    }
+
+    if (num_ranges > kMaxIncrementalInsert)
+    {
+        // Compact in one pass and merge added rows in O(N)
+        beginResetModel();
+        removeRows(removed);
+        int size = m_rows.size();
+        m_rows.insert(m_rows.end(), added.begin(), added.end());
+        std::inplace_merge(m_rows.begin(), m_rows.begin() + size, m_rows.end(), less);
+        endResetModel();
+        return;
+    }
+
+    // Remove from the back, so positions of the rest stay valid
+    std::vector<std::pair<int, int>> ranges;
+    forEachRange(removed, [&ranges](int begin, int end)
+                 { ranges.emplace_back(begin, end); });
+    for (auto it = ranges.rbegin(); it != ranges.rend(); it++)
+    {
+        beginRemoveRows(QModelIndex(), it->first, it->second - 1);
+        m_rows.erase(m_rows.begin() + it->first, m_rows.begin() + it->second);
+        endRemoveRows();
+    }
+
+    // Added rows with the same position form a contiguous block, insert blocks from the back
+    for (size_t end = added.size(); end > 0;)
+    {
+        size_t begin = end - 1;
+        while (begin > 0 && insert_pos[begin - 1] == insert_pos[end - 1])
+        {
+            begin--;
+        }
+        int pos = insert_pos[begin];
+        beginInsertRows(QModelIndex(), pos, pos + (end - begin) - 1);
+        m_rows.insert(m_rows.begin() + pos, added.begin() + begin, added.begin() + end);
+        endInsertRows();
+        end = begin;
+    }
+}
+
+template <typename Func>
+void TaskFilterModel::forEachRange(const std::vector<int> &positions, Func func)
+{
+    for (size_t begin = 0; begin < positions.size();)
+    {
+        size_t end = begin + 1;
+        while (end < positions.size() && positions[end] == positions[end - 1] + 1)
+        {
+            end++;
+        }
+        func(positions[begin], positions[end - 1] + 1);
+        begin = end;
+    }
+}
+
+void TaskFilterModel::removeRows(const std::vector<int> &positions)
+{
+    auto out = m_rows.begin();
+    size_t next = 0;
+    for (int pos = 0; pos < static_cast<int>(m_rows.size()); pos++)
+    {
+        if (next < positions.size() && positions[next] == pos)
+        {
+            next++;
+            continue;
+        }
+        *out++ = m_rows[pos];
+    }
+    m_rows.erase(out, m_rows.end());
+}
+
+void TaskFilterModel::onModelAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void TaskFilterModel::onModelReset()
+{
+    rebuild();
+    endResetModel();
+}
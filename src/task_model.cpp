@@ -1,30 +1,103 @@
 #include "task_model.hpp"
+#include <QDir>
 #include <QMetaEnum>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Limits of the pool, submissions above them are rejected
+    const size_t kMaxQueuedTasks = 1000000;
+    const size_t kMaxResultBytes = size_t(2) << 30;
+
+    // Factorials are memory bandwidth bound, running them on every core slows everything down
+    size_t heavyTaskLimit()
+    {
+        return std::max(1u, std::thread::hardware_concurrency() / 2);
+    }
+
+    /**
+     * @brief Resumable job that writes its status and result into the task table instead of the promise
+     */
+    template <typename Job>
+    class TableJob
+    {
+    public:
+        TableJob(Job &&job, TP::TaskTable *table) : m_job(std::move(job)), m_table(table) {}
+
+        bool step(std::chrono::steady_clock::time_point deadline)
+        {
+            size_t task_idx = TP::ThreadPool::current_task_id();
+            if (!m_started)
+            {
+                m_table->set_started(task_idx);
+                m_started = true;
+            }
+
+            try
+            {
+                if (!m_job.step(deadline))
+                    return false;
+                m_table->set_result(task_idx, std::unique_ptr<TP::TaskResult>(new TP::ValueResult(m_job.result())));
+            }
+            catch (const std::exception &e)
+            {
+                m_table->set_result(task_idx, std::unique_ptr<TP::TaskResult>(new TP::ErrorResult(e.what())));
+            }
+            return true;
+        }
+
+        void result() const {}
+
+    private:
+        Job m_job;
+        TP::TaskTable *m_table;
+        bool m_started = false;
+    };
+
+    template <typename Job>
+    TableJob<Job> tableJob(Job job, TP::TaskTable *table)
+    {
+        return TableJob<Job>(std::move(job), table);
+    }
+}
 
 TaskModel::TaskModel()
 {
-    // Emit signals based on events from thread pool
-    m_pool.set_async_callback([&](size_t task_idx, bool state)
-                             {
-        // Update progress bar
-        if (state)
-            emit numFinishedChanged();
+    TP::QueueLimits limits;
+    limits.max_tasks = kMaxQueuedTasks;
+    limits.max_bytes = kMaxResultBytes;
+    limits.policy = TP::AdmissionPolicy::Reject;
+    m_pool.set_limits(limits);
+
+    // Resource group per task type
+    QMetaEnum e = QMetaEnum::fromType<TaskTypes>();
+    for (int i = 0; i < e.keyCount(); i++)
+    {
+        auto task_type = static_cast<TaskTypes>(e.value(i));
+        size_t max_running = (task_type == TaskTypes::Fibonacci) ? 0 : heavyTaskLimit();
+        m_type_groups.push_back(m_pool.add_group(e.key(i), max_running));
+    }
 
-        // Get row index by task index if possible
-        std::unique_lock<std::mutex> id_map_lock(m_id_map_mtx);
-        if (!m_id_map.count(task_idx))
-            return;
-        size_t row_idx = m_id_map[task_idx];
-        id_map_lock.unlock();
+    // Counters of tasks in every status change with the total and finished ones
+    connect(this, &TaskModel::numTotalChanged, this, &TaskModel::numStatusChanged);
+    connect(this, &TaskModel::numFinishedChanged, this, &TaskModel::numStatusChanged);
 
-        // Emit list update signal
-        emit dataChanged(index(row_idx), index(row_idx), 
-            state ? QVector<int>{StatusRole, ResultRole} : QVector<int>{StatusRole}); });
+    // Tasks write their status into the table, updates are sent to the GUI in batches once per interval
+    m_flush_timer.setSingleShot(true);
+    connect(&m_flush_timer, &QTimer::timeout, this, &TaskModel::flushUpdates);
+    connect(this, &TaskModel::updatesPending, this, &TaskModel::scheduleFlush, Qt::QueuedConnection);
+    m_table.set_dirty_callback([this]
+                               { emit updatesPending(); });
 }
 
 int TaskModel::rowCount(const QModelIndex &parent) const
 {
-    return m_tasks.size();
+    return m_table.size();
 }
 
 QVariant TaskModel::data(const QModelIndex &index, int role) const
@@ -36,13 +109,13 @@ QVariant TaskModel::data(const QModelIndex &index, int role) const
     switch (role)
     {
     case NameRole:
-        return QString::fromStdString(m_tasks[index.row()]->name());
+        return taskName(taskType(index.row()), taskArg(index.row()));
     case StatusRole:
-        return QVariant::fromValue(m_tasks[index.row()]->status());
+        return QVariant::fromValue(m_table.status(index.row()));
     case ResultRole:
-        return QString::fromStdString(m_tasks[index.row()]->result_str());
+        return QString::fromStdString(m_table.result_str(index.row()));
     case SelectedRole:
-        return (bool)m_selected.count(m_tasks[index.row()]->id());
+        return (bool)m_selected.count(m_table.id(index.row()));
     }
 
     return QVariant();
@@ -60,12 +133,12 @@ bool TaskModel::setData(const QModelIndex &index, const QVariant &v, int role)
         if (v.value<bool>())
         {
             // Add task to selected if checkbox changed state to checked
-            m_selected.insert(m_tasks[index.row()]->id());
+            m_selected.insert(m_table.id(index.row()));
         }
         else
         {
             // Add task to selected if checkbox changed state to unchecked
-            m_selected.erase(m_tasks[index.row()]->id());
+            m_selected.erase(m_table.id(index.row()));
         }
 
         // Emit signals
@@ -101,69 +174,167 @@ QList<QVariant> TaskModel::taskTypes()
     return task_types;
 }
 
-bool TaskModel::addTask(TaskTypes task_type, const QVariant &arg, bool enbl_emit)
+size_t TaskModel::taskCost(TaskTypes task_type, int arg)
 {
-    // Add task into thread pool
-    std::unique_ptr<TP::ITaskInfo> task_info;
     switch (task_type)
     {
     case TaskTypes::Fibonacci:
-        task_info = m_pool.add_task_uptr(tasks::fib, arg.value<int>());
-        break;
+        return tasks::fib_bytes(arg);
     case TaskTypes::Factorial:
-        task_info = m_pool.add_task_uptr(tasks::factorial, arg.value<int>());
-        break;
+        return tasks::factorial_bytes(arg);
     case TaskTypes::DoubleFactorial:
-        task_info = m_pool.add_task_uptr(tasks::double_factorial, arg.value<int>());
-        break;
+        return tasks::double_factorial_bytes(arg);
     }
+    return 0;
+}
 
-    // Add task_info to list if it was created
-    if (task_info)
+bool TaskModel::submitTask(TaskTypes task_type, int arg, size_t &task_idx)
+{
+    TP::TaskOptions options;
+    options.cost_bytes = taskCost(task_type, arg);
+    options.group = m_type_groups[static_cast<int>(task_type)];
+
+    // Results are written into the table, futures of the pool are not kept
+    TP::TaskTable *table = &m_table;
+    TP::TaskInfo<void> info(0, std::future<void>(), std::future<void>());
+
+    // Execute in worker process if it is available
+    uint32_t func_id = 0;
+    if (m_processes_active &&
+        TP::ProcessBackend::find_function(QMetaEnum::fromType<TaskTypes>().valueToKey(static_cast<int>(task_type)), func_id))
+    {
+        TP::ProcessBackend *processes = &m_processes;
+        info = m_pool.add_task(options, [processes, table, func_id, arg]
+                               {
+            size_t idx = TP::ThreadPool::current_task_id();
+            table->set_started(idx);
+            try
+            {
+                table->set_result(idx, std::unique_ptr<TP::TaskResult>(new TP::ValueResult(processes->call(func_id, arg))));
+            }
+            catch (const std::exception &e)
+            {
+                table->set_result(idx, std::unique_ptr<TP::TaskResult>(new TP::ErrorResult(e.what())));
+            } });
+    }
+    else
     {
-        if (enbl_emit)
+        switch (task_type)
         {
-            beginInsertRows(QModelIndex(), rowCount(), rowCount());
+        case TaskTypes::Fibonacci:
+            info = m_pool.add_resumable_task(options, tableJob(tasks::fib_job(arg), table));
+            break;
+        case TaskTypes::Factorial:
+            info = m_pool.add_resumable_task(options, tableJob(tasks::factorial_job(arg), table));
+            break;
+        case TaskTypes::DoubleFactorial:
+            info = m_pool.add_resumable_task(options, tableJob(tasks::double_factorial_job(arg), table));
+            break;
         }
+    }
 
-        // Put task_info into list
-        QString task_name = QVariant::fromValue(task_type).toString() + "(" + arg.toString() + ")";
-        task_info->name() = task_name.toStdString();
-        m_tasks.emplace_back(std::move(task_info));
+    if (!info.valid())
+        return false;
+    task_idx = info.id();
+    return true;
+}
 
-        if (enbl_emit)
-        {
-            emit numTotalChanged();
-            endInsertRows();
-        }
+QString TaskModel::taskName(TaskTypes task_type, int arg)
+{
+    return QString(QMetaEnum::fromType<TaskTypes>().valueToKey(static_cast<int>(task_type))) + "(" + QString::number(arg) + ")";
+}
 
-        return true;
+void TaskModel::appendRows(std::vector<NewRow> &rows)
+{
+    if (rows.empty())
+        return;
+
+    beginInsertRows(QModelIndex(), rowCount(), rowCount() - 1 + rows.size());
+    for (auto &row : rows)
+    {
+        m_table.append(row.id, static_cast<uint32_t>(row.type), row.arg, std::move(row.result));
     }
+    endInsertRows();
 
-    return false;
+    // Emit signal num total
+    emit numTotalChanged();
+}
+
+bool TaskModel::addTask(TaskTypes task_type, const QVariant &arg, bool enbl_emit)
+{
+    int value = arg.value<int>();
+    if (!TP::TaskTable::fits(value))
+    {
+        m_num_refused++;
+        emit numRejectedChanged();
+        return false;
+    }
+
+    // Add task into thread pool
+    size_t task_idx;
+    if (!submitTask(task_type, value, task_idx))
+    {
+        emit numRejectedChanged();
+        return false;
+    }
+
+    if (enbl_emit)
+    {
+        beginInsertRows(QModelIndex(), rowCount(), rowCount());
+    }
+
+    // Put task into table
+    m_table.append(task_idx, static_cast<uint32_t>(task_type), value);
+
+    if (enbl_emit)
+    {
+        emit numTotalChanged();
+        endInsertRows();
+    }
+
+    return true;
 }
 
 void TaskModel::addTasksRandom(int n, int min_value, int max_value)
 {
+    if (n <= 0)
+        return;
+
+    // Range clamped to the table could be empty (undefined for the distribution)
+    int min_arg = std::max(min_value, TP::TaskTable::kMinArg);
+    int max_arg = std::min(max_value, TP::TaskTable::kMaxArg);
+    if (min_arg > max_arg)
+    {
+        m_num_refused += n;
+        emit numRejectedChanged();
+        return;
+    }
+
     QMetaEnum e = QMetaEnum::fromType<TaskTypes>();
     std::uniform_int_distribution<> task_distrib(0, e.keyCount() - 1);
-    std::uniform_int_distribution<> arg_distrib(min_value, max_value);
+    std::uniform_int_distribution<> arg_distrib(min_arg, max_arg);
 
-    beginInsertRows(QModelIndex(), rowCount(), rowCount() - 1 + n);
+    // Submit first, rejected tasks do not get rows
+    std::vector<NewRow> rows;
+    rows.reserve(n);
     for (int i = 0; i < n; i++)
     {
-        addTask(static_cast<TaskTypes>(task_distrib(m_rand_gen)), arg_distrib(m_rand_gen), false);
+        auto task_type = static_cast<TaskTypes>(task_distrib(m_rand_gen));
+        int arg = arg_distrib(m_rand_gen);
+        size_t task_idx;
+        if (submitTask(task_type, arg, task_idx))
+            rows.push_back(NewRow{task_idx, task_type, arg, nullptr});
     }
-    endInsertRows();
 
-    // Emit signal num total
-    emit numTotalChanged();
+    if (static_cast<int>(rows.size()) != n)
+        emit numRejectedChanged();
+    appendRows(rows);
 }
 
 void TaskModel::removeTasks()
 {
-    // Copy m_selected (because the next step will partially clear it)
-    auto selected = m_selected;
+    // Copy m_selected (because the next step will partially clear it), cheap for interval sets
+    TP::SelectionSet selected = m_selected;
 
     // Remove tasks from pool (and clears m_selected from all indexes that were in queue)
     m_pool.remove_tasks(m_selected);
@@ -174,28 +345,31 @@ void TaskModel::removeTasks()
     // Remove using remove&erase idiom
     auto &remaining_idxs = m_selected; // Symlink m_selected for convinience
     auto &counter = m_num_finished_removed;
-    m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(),
-                                [&selected, &remaining_idxs, &counter](const std::unique_ptr<TP::ITaskInfo> &task)
-                                {
-                                    // Check if the task has been deleted from pool
-                                    bool deleted_from_pool = !remaining_idxs.count(task->id());
-                                    // Task should be deleted if it's selected and either was deleted from pool or finished
-                                    bool remove = (selected.count(task->id()) &&
-                                                   (deleted_from_pool || (task->status() == TP::TaskStatus::Completed)));
-                                    // Delete already finished task
-                                    if (remove && !deleted_from_pool)
-                                    {
-                                        remaining_idxs.erase(task->id());
-                                        counter++;
-                                    }
-                                    return remove;
-                                }),
-                 m_tasks.end());
-
-    // Invalidate idMap
-    std::unique_lock<std::mutex> id_map_lock(m_id_map_mtx);
-    m_id_map.clear();
-    id_map_lock.unlock();
+    size_t released_bytes = 0;
+    m_table.remove_if([this, &selected, &remaining_idxs, &counter, &released_bytes](size_t row, TP::TaskStatus status,
+                                                                                     const TP::TaskResult *result)
+                      {
+                          size_t id = m_table.id(row);
+                          // Check if the task has been deleted from pool
+                          bool deleted_from_pool = !remaining_idxs.count(id);
+                          // Task should be deleted if it's selected and either was deleted from pool or finished
+                          bool remove = (selected.count(id) &&
+                                         (deleted_from_pool || (status == TP::TaskStatus::Completed)));
+                          // Delete already finished task
+                          if (remove && !deleted_from_pool)
+                          {
+                              remaining_idxs.erase(id);
+                              // Restored results are not accounted by the pool, cancelled tasks are released by it
+                              if (!dynamic_cast<const TP::SnapshotResult *>(result) &&
+                                  !dynamic_cast<const TP::CancelledResult *>(result))
+                                  released_bytes += taskCost(taskType(row), taskArg(row));
+                              counter++;
+                          }
+                          return remove;
+                      });
+
+    // Results of finished tasks are dropped, free their memory budget
+    m_pool.release_bytes(released_bytes);
 
     // Emit signals
     endResetModel();
@@ -204,36 +378,278 @@ void TaskModel::removeTasks()
     emit numFinishedChanged();
 }
 
-void TaskModel::selectTasksAll(bool select)
+void TaskModel::pauseTasks()
 {
-    if (select)
+    m_pool.pause_tasks(m_selected);
+}
+
+void TaskModel::resumeTasks()
+{
+    m_pool.resume_tasks(m_selected);
+}
+
+void TaskModel::cancelTasksIfNotStarted(int timeout_ms)
+{
+    // Removal by the timer is reported like a finished task, so the row and progress are updated by flushUpdates
+    TP::TaskTable *table = &m_table;
+    std::atomic<size_t> *num_cancelled = &m_num_cancelled;
+    auto on_cancelled = [table, num_cancelled](size_t task_idx)
     {
-        for (const auto &task : m_tasks)
+        (*num_cancelled)++;
+        table->set_result(task_idx, std::unique_ptr<TP::TaskResult>(new TP::CancelledResult()));
+    };
+
+    // Only existing queued rows, intervals could contain ids of removed rows
+    for (const auto &interval : m_selected.intervals())
+    {
+        size_t end = m_table.lower_bound(interval.second);
+        for (size_t row = m_table.lower_bound(interval.first); row < end; row++)
         {
-            m_selected.insert(task->id());
+            if (m_table.status(row) == TP::TaskStatus::InQueue)
+                m_pool.cancel_if_not_started(m_table.id(row), std::chrono::milliseconds(timeout_ms), on_cancelled);
         }
     }
-    else
+}
+
+QString TaskModel::snapshotPath(const QString &path)
+{
+    if (!path.isEmpty())
+        return path;
+
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    return QDir(dir).filePath("tasks.snapshot");
+}
+
+bool TaskModel::saveSnapshot(const QString &path)
+{
+    TP::SnapshotWriter writer(snapshotPath(path).toStdString(), m_table.size());
+    for (size_t row = 0; row < m_table.size(); row++)
     {
-        m_selected.clear();
+        // Result is read first, the status could only move forward
+        const TP::TaskResult *result = m_table.result(row);
+
+        TP::SnapshotRecord record = {};
+        record.id = m_table.id(row);
+        record.type = m_table.type(row);
+        record.arg = m_table.arg(row);
+        record.status = static_cast<uint8_t>(result ? TP::TaskStatus::Completed : m_table.status(row));
+
+        // Copy raw limbs of tasks restored from previous snapshot
+        if (auto restored = dynamic_cast<const TP::SnapshotResult *>(result))
+        {
+            const auto &src = restored->snapshot().record(restored->pos());
+            writer.add_raw(record, restored->snapshot().limbs(restored->pos()), src.result_size, src.negative);
+            continue;
+        }
+
+        // Result of the task computed by the pool
+        if (auto computed = dynamic_cast<const TP::ValueResult *>(result))
+        {
+            writer.add(record, &computed->value());
+            continue;
+        }
+
+        // Result is not available (e.g. failed task), the task will be recomputed
+        if (record.status == static_cast<uint8_t>(TP::TaskStatus::Completed))
+            record.status = static_cast<uint8_t>(TP::TaskStatus::InQueue);
+        writer.add(record, nullptr);
+    }
+
+    return writer.finish();
+}
+
+bool TaskModel::loadSnapshot(const QString &path)
+{
+    auto snapshot = TP::Snapshot::open(snapshotPath(path).toStdString());
+    if (!snapshot)
+        return false;
+
+    // Skip records with unknown task types
+    QMetaEnum e = QMetaEnum::fromType<TaskTypes>();
+    auto is_valid = [&snapshot, &e](size_t i)
+    { return snapshot->record(i).type < static_cast<uint32_t>(e.keyCount()) && TP::TaskTable::fits(snapshot->record(i).arg); };
+
+    int n = 0;
+    for (size_t i = 0; i < snapshot->size(); i++)
+    {
+        n += is_valid(i);
+    }
+
+    // Submit first, tasks rejected by the pool do not get rows
+    std::vector<NewRow> rows;
+    rows.reserve(n);
+    for (size_t i = 0; i < snapshot->size(); i++)
+    {
+        if (!is_valid(i))
+            continue;
+
+        const TP::SnapshotRecord &record = snapshot->record(i);
+        auto task_type = static_cast<TaskTypes>(record.type);
+
+        // Completed tasks keep results in the mapped file, the rest is computed again
+        size_t task_idx;
+        if (record.status == static_cast<uint8_t>(TP::TaskStatus::Completed))
+        {
+            std::unique_ptr<TP::TaskResult> result(new TP::SnapshotResult(snapshot, i));
+            rows.push_back(NewRow{m_pool.reserve_idx(), task_type, record.arg, std::move(result)});
+            m_num_finished_restored++;
+        }
+        else if (submitTask(task_type, record.arg, task_idx))
+        {
+            rows.push_back(NewRow{task_idx, task_type, record.arg, nullptr});
+        }
+    }
+
+    if (static_cast<int>(rows.size()) != n)
+        emit numRejectedChanged();
+    if (rows.empty())
+        return true;
+
+    appendRows(rows);
+    emit numFinishedChanged();
+    return true;
+}
+
+void TaskModel::selectTasksAll(bool select)
+{
+    // Ids of rows are increasing, all rows are a single interval
+    m_selected.clear();
+    if (select && !m_table.empty())
+    {
+        m_selected.insert_range(m_table.id(0), m_table.id(m_table.size() - 1) + 1);
     }
     emit dataChanged(index(0), index(rowCount() - 1), {SelectedRole});
     emit numSelectedChanged();
 }
 
-void TaskModel::updateIdMap(int row_idx)
+void TaskModel::selectTasksRange(int first_row, int last_row, bool select)
+{
+    first_row = std::max(first_row, 0);
+    last_row = std::min(last_row, rowCount() - 1);
+    if (first_row > last_row)
+        return;
+
+    size_t first_id = m_table.id(first_row);
+    size_t last_id = m_table.id(last_row) + 1;
+    if (select)
+        m_selected.insert_range(first_id, last_id);
+    else
+        m_selected.erase_range(first_id, last_id);
+
+    emit dataChanged(index(first_row), index(last_row), {SelectedRole});
+    emit numSelectedChanged();
+}
+
+int TaskModel::rowById(size_t task_idx) const
+{
+    size_t row_idx;
+    if (!m_table.find(task_idx, row_idx))
+        return -1;
+    return row_idx;
+}
+
+int TaskModel::updateInterval() const
+{
+    return m_update_interval;
+}
+
+void TaskModel::setUpdateInterval(int interval_ms)
 {
-    if (row_idx < 0 || row_idx >= rowCount())
+    interval_ms = std::max(interval_ms, 0);
+    if (interval_ms == m_update_interval)
         return;
 
-    // Lock and update idMap
-    std::lock_guard<std::mutex> id_map_lock(m_id_map_mtx);
-    m_id_map[m_tasks[row_idx]->id()] = row_idx;
+    m_update_interval = interval_ms;
+    emit updateIntervalChanged();
+}
+
+void TaskModel::scheduleFlush()
+{
+    if (!m_flush_timer.isActive())
+        m_flush_timer.start(m_update_interval);
+}
+
+void TaskModel::flushUpdates()
+{
+    // Rows of updated tasks, removed ones are skipped
+    std::vector<int> rows;
+    for (uint64_t task_idx : m_table.take_dirty())
+    {
+        int row_idx = rowById(task_idx);
+        if (row_idx >= 0)
+            rows.push_back(row_idx);
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // One signal per contiguous range of rows
+    for (size_t first = 0; first < rows.size();)
+    {
+        size_t last = first;
+        while (last + 1 < rows.size() && rows[last + 1] == rows[last] + 1)
+        {
+            last++;
+        }
+        emit dataChanged(index(rows[first]), index(rows[last]), {StatusRole, ResultRole});
+        first = last + 1;
+    }
+
+    // Single progress notification (numFinishedChanged is followed by numStatusChanged)
+    int finished = numFinished();
+    int in_process = numInProcess();
+    bool counters_changed = finished != m_flushed_finished || in_process != m_flushed_in_process;
+    if (finished != m_flushed_finished)
+        emit numFinishedChanged();
+    else if (counters_changed)
+        emit numStatusChanged();
+    m_flushed_finished = finished;
+    m_flushed_in_process = in_process;
+
+    // Counters of the pool are updated after the task has written its result, check them once more
+    if (!rows.empty() || counters_changed)
+        scheduleFlush();
+}
+
+void TaskModel::registerRemoteTasks()
+{
+    TP::ProcessBackend::register_function("Fibonacci", tasks::fib);
+    TP::ProcessBackend::register_function("Factorial", tasks::factorial);
+    TP::ProcessBackend::register_function("DoubleFactorial", tasks::double_factorial);
+}
+
+bool TaskModel::startProcesses(int num_processes)
+{
+    if (num_processes <= 0 || !m_processes.start(num_processes))
+        return false;
+    m_processes_active = true;
+    return true;
+}
+
+bool TaskModel::stopProcesses()
+{
+    m_processes_active = false;
+    return m_processes.stop();
+}
+
+bool TaskModel::setPlacement(const QString &policy, bool bind_memory)
+{
+    if (policy == "none")
+        m_start_options.affinity = TP::AffinityPolicy::None;
+    else if (policy == "compact")
+        m_start_options.affinity = TP::AffinityPolicy::Compact;
+    else if (policy == "scatter")
+        m_start_options.affinity = TP::AffinityPolicy::Scatter;
+    else
+        return false;
+
+    m_start_options.bind_memory = bind_memory;
+    return true;
 }
 
 bool TaskModel::startPool(int num_threads)
 {
-    return m_pool.start(num_threads);
+    return m_pool.start(num_threads, m_start_options);
 }
 
 bool TaskModel::stopPool()
@@ -243,10 +659,32 @@ bool TaskModel::stopPool()
 
 int TaskModel::numFinished() const
 {
-    return m_pool.num_finished() - m_num_finished_removed;
+    return m_pool.num_finished() + m_num_finished_restored + m_num_cancelled - m_num_finished_removed;
+}
+
+int TaskModel::numInQueue() const
+{
+    // Finishing task is not counted as in process for a moment, it is shown as queued then
+    return std::max(0, rowCount() - numFinished() - numInProcess());
+}
+
+int TaskModel::numInProcess() const
+{
+    return m_pool.num_in_process();
 }
 
 int TaskModel::numSelected() const
 {
-    return m_selected.size();
+    // Intervals could contain ids of removed rows, count only existing ones
+    size_t n = 0;
+    for (const auto &interval : m_selected.intervals())
+    {
+        n += m_table.lower_bound(interval.second) - m_table.lower_bound(interval.first);
+    }
+    return n;
+}
+
+int TaskModel::numRejected() const
+{
+    return m_pool.num_rejected() + m_num_refused;
 }
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "task_table.hpp"
+
+#include <algorithm>
+
+namespace TP
+{
+    TaskStatus TaskTable::status(size_t row) const
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return static_cast<TaskStatus>(m_status[row]);
+    }
+
+    const TaskResult *TaskTable::result(size_t row) const
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_results[row].get();
+    }
+
+    std::string TaskTable::result_str(size_t row) const
+    {
+        // Result is never changed once set and is removed only by the owner thread
+        const TaskResult *res = result(row);
+        return res ? res->str() : std::string();
+    }
+
+    size_t TaskTable::lower_bound(uint64_t id) const
+    {
+        return std::lower_bound(m_ids.begin(), m_ids.end(), id) - m_ids.begin();
+    }
+
+    bool TaskTable::find(uint64_t id, size_t &row) const
+    {
+        row = lower_bound(id);
+        return row < m_ids.size() && m_ids[row] == id;
+    }
+
+    void TaskTable::append(uint64_t id, uint32_t type, int32_t arg, std::unique_ptr<TaskResult> &&result)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        TaskStatus status = result ? TaskStatus::Completed : TaskStatus::InQueue;
+
+        // Apply updates of the task that has started already, drop updates of tasks that never got rows
+        auto pending_it = m_pending.begin();
+        while (pending_it != m_pending.end() && pending_it->first <= id)
+        {
+            if (pending_it->first == id)
+            {
+                status = pending_it->second.status;
+                result = std::move(pending_it->second.result);
+            }
+            pending_it = m_pending.erase(pending_it);
+        }
+
+        m_ids.push_back(id);
+        m_keys.push_back(type | (static_cast<uint32_t>(arg) << kTypeBits));
+        m_status.push_back(static_cast<uint8_t>(status));
+        m_results.push_back(std::move(result));
+    }
+
+    bool TaskTable::find_locked(uint64_t id, size_t &row, Pending *&pending)
+    {
+        pending = nullptr;
+        if (find(id, row))
+            return true;
+
+        // Rows are appended in order of ids, a smaller id belongs to a removed row
+        if (m_ids.empty() || id > m_ids.back())
+            pending = &m_pending[id];
+        return false;
+    }
+
+    void TaskTable::set_started(uint64_t id)
+    {
+        bool first = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+
+            size_t row;
+            Pending *pending;
+            if (find_locked(id, row, pending))
+            {
+                if (m_status[row] == static_cast<uint8_t>(TaskStatus::InQueue))
+                {
+                    m_status[row] = static_cast<uint8_t>(TaskStatus::InProcess);
+                    first = mark_dirty(id);
+                }
+            }
+            else if (pending && !pending->result)
+            {
+                pending->status = TaskStatus::InProcess;
+            }
+        }
+        notify_dirty(first);
+    }
+
+    void TaskTable::set_result(uint64_t id, std::unique_ptr<TaskResult> &&result)
+    {
+        bool first = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+
+            size_t row;
+            Pending *pending;
+            if (find_locked(id, row, pending))
+            {
+                m_status[row] = static_cast<uint8_t>(TaskStatus::Completed);
+                m_results[row] = std::move(result);
+                first = mark_dirty(id);
+            }
+            else if (pending)
+            {
+                pending->status = TaskStatus::Completed;
+                pending->result = std::move(result);
+            }
+        }
+        notify_dirty(first);
+    }
+
+    std::vector<uint64_t> TaskTable::take_dirty()
+    {
+        std::vector<uint64_t> dirty;
+        std::lock_guard<std::mutex> lock(m_mtx);
+        dirty.swap(m_dirty);
+        return dirty;
+    }
+
+    bool TaskTable::mark_dirty(uint64_t id)
+    {
+        m_dirty.push_back(id);
+        return m_dirty.size() == 1;
+    }
+
+    void TaskTable::notify_dirty(bool first)
+    {
+        if (first && m_dirty_callback)
+            m_dirty_callback();
+    }
+}
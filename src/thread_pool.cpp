@@ -1,18 +1,93 @@
 #include "thread_pool.hpp"
 
+#include <algorithm>
+#include <thread>
+
 namespace TP
 {
+    namespace
+    {
+        // Hint to the CPU that the thread is busy-waiting
+        inline void cpu_relax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        // Index of the task executed by the calling worker thread
+        thread_local size_t t_current_task = ThreadPool::kNoTask;
+
+        // Union and difference of index sets, interval sets are handled interval by interval
+        void insert_all(SelectionSet &dst, const SelectionSet &src)
+        {
+            for (const auto &interval : src.intervals())
+            {
+                dst.insert_range(interval.first, interval.second);
+            }
+        }
 
-    bool ThreadPool::start(size_t num_threads)
+        void insert_all(SelectionSet &dst, const std::unordered_set<size_t> &src)
+        {
+            for (size_t idx : src)
+            {
+                dst.insert(idx);
+            }
+        }
+
+        void erase_all(SelectionSet &dst, const SelectionSet &src)
+        {
+            for (const auto &interval : src.intervals())
+            {
+                dst.erase_range(interval.first, interval.second);
+            }
+        }
+
+        void erase_all(SelectionSet &dst, const std::unordered_set<size_t> &src)
+        {
+            for (size_t idx : src)
+            {
+                dst.erase(idx);
+            }
+        }
+    }
+
+    ThreadPool::ThreadPool()
+    {
+        m_groups.emplace_back("default", 0);
+        m_clients.emplace_back("default", 1);
+    }
+
+    bool ThreadPool::start(size_t num_threads, const StartOptions &options)
     {
         if (m_active)
             return false;
 
+        // Compute CPU for every thread
+        CpuTopology topology = CpuTopology::detect();
+        std::vector<int> cpus = topology.placement(num_threads, options.affinity);
+
         // Create threads
+        m_options = options;
+        m_placement_failures = 0;
         m_active = true;
         for (size_t i = 0; i < num_threads; i++)
         {
-            m_threads.emplace_back(&ThreadPool::run, this);
+            int cpu = cpus[i];
+            int node = options.bind_memory ? topology.node_of(cpu) : -1;
+            m_threads.emplace_back([this, cpu, node]
+                                   {
+                // Pin before the first allocation, so thread memory is touched on its own node
+                // Failures are counted, the thread runs unpinned (see num_placement_failures)
+                if (cpu >= 0 && !pin_current_thread(cpu))
+                    m_placement_failures++;
+                if (node >= 0 && !bind_current_thread_memory(node))
+                    m_placement_failures++;
+                run(); });
         }
 
         return true;
@@ -34,80 +109,765 @@ namespace TP
         return true;
     }
 
-    void ThreadPool::remove_tasks(std::unordered_set<size_t> &idxs)
+    template <typename Set>
+    void ThreadPool::remove_tasks_impl(Set &idxs, bool keep_started)
     {
         std::lock_guard<std::mutex> q_lock(m_queue_mtx);
 
-        if (idxs.size() < 100 && idxs.size() < m_tasks.size() / 10)
+        // Untracked jobs (see post) share ids with tasks, but are never removed by them:
+        // internal jobs (e.g. coroutine resumptions) have to run
+
+        // Remove delayed tasks, their timers are not needed anymore
+        for (auto delayed_it = m_delayed.begin(); delayed_it != m_delayed.end();)
         {
-            // Remove using binary search for small number of tasks to be deleted
-            for (auto idxs_it = idxs.begin(); idxs_it != idxs.end();)
+            size_t idx = delayed_it->first;
+            if (!delayed_it->second.element.tracked || !idxs.count(idx) || m_dependents.count(idx))
             {
-                // Get id of task to be removed from iterator
-                auto idx = *idxs_it;
+                delayed_it++;
+                continue;
+            }
+            m_timers.cancel(delayed_it->second.timer_id);
+            release_admission(delayed_it->second.element, true);
+            delayed_it = m_delayed.erase(delayed_it);
+            idxs.erase(idx);
+        }
 
-                // Find task by id
-                auto tasks_it = std::lower_bound(m_tasks.begin(), m_tasks.end(), idx,
-                                                 [](const QueueElement &task, size_t target_idx)
-                                                 { return task.idx < target_idx; });
-                // Check if task was found
-                if (tasks_it == m_tasks.end() || tasks_it->idx != idx)
+        // Remove waiting tasks first, so their dependencies become removable
+        // Repeat until nothing changes, because waiting tasks could depend on each other
+        bool removed = true;
+        while (removed && !m_waiting.empty())
+        {
+            removed = false;
+            for (auto it = m_waiting.begin(); it != m_waiting.end();)
+            {
+                if (!it->second.element.tracked || !idxs.count(it->first) || m_dependents.count(it->first))
                 {
-                    idxs_it++;
+                    it++;
                     continue;
                 }
 
-                // Remove task
-                idxs_it = idxs.erase(idxs_it);
-                m_tasks.erase(tasks_it);
+                // Unlink task from dependency graph
+                for (size_t dep : it->second.deps)
+                {
+                    auto dep_it = m_dependents.find(dep);
+                    if (dep_it == m_dependents.end())
+                        continue;
+                    auto &dependents = dep_it->second;
+                    dependents.erase(std::remove(dependents.begin(), dependents.end(), it->first), dependents.end());
+                    if (dependents.empty())
+                        m_dependents.erase(dep_it);
+                }
+
+                release_admission(it->second.element, true);
+                idxs.erase(it->first);
+                it = m_waiting.erase(it);
+                removed = true;
+            }
+        }
+
+        // Remove paused tasks
+        for (auto paused_it = m_paused.begin(); paused_it != m_paused.end();)
+        {
+            size_t idx = paused_it->first;
+            if (!idxs.count(idx) || m_dependents.count(idx) || (keep_started && paused_it->second.started))
+            {
+                paused_it++;
+                continue;
+            }
+            m_pause_requested.erase(idx);
+            release_admission(paused_it->second, true);
+            paused_it = m_paused.erase(paused_it);
+            idxs.erase(idx);
+        }
+
+        // Remove queued tasks
+        for (auto &client : m_clients)
+        {
+            for (size_t group_idx = 0; group_idx < client.queues.size(); group_idx++)
+            {
+                if (idxs.empty())
+                    break;
+
+                auto &queue = client.queues[group_idx];
+                auto &tasks = queue.tasks;
+                size_t size_before = tasks.size();
+                if (queue.sorted && idxs.size() < 100 && idxs.size() < tasks.size() / 10)
+                {
+                    // Remove using binary search for small number of tasks to be deleted
+                    std::vector<size_t> removed_idxs;
+                    for (size_t idx : idxs)
+                    {
+                        // Find task by id
+                        auto tasks_it = std::lower_bound(tasks.begin(), tasks.end(), idx,
+                                                         [](const QueueElement &task, size_t target_idx)
+                                                         { return task.idx < target_idx; });
+                        // Check if task was found and nothing depends on it
+                        if (tasks_it == tasks.end() || tasks_it->idx != idx || !tasks_it->tracked ||
+                            m_dependents.count(idx) || (keep_started && tasks_it->started))
+                            continue;
+
+                        // Remove task
+                        release_admission(*tasks_it, true);
+                        tasks.erase(tasks_it);
+                        removed_idxs.push_back(idx);
+                    }
+                    for (size_t idx : removed_idxs)
+                    {
+                        idxs.erase(idx);
+                    }
+                }
+                else
+                {
+                    // Remove using remove&erase idiom
+                    tasks.erase(std::remove_if(tasks.begin(), tasks.end(),
+                                               [this, &idxs, keep_started](const QueueElement &task)
+                                               {
+                                                   bool to_delete = task.tracked && idxs.count(task.idx) &&
+                                                                    !m_dependents.count(task.idx) &&
+                                                                    !(keep_started && task.started);
+                                                   if (to_delete)
+                                                   {
+                                                       idxs.erase(task.idx);
+                                                       release_admission(task, true);
+                                                   }
+                                                   return to_delete;
+                                               }),
+                                tasks.end());
+                }
+
+                size_t removed_count = size_before - tasks.size();
+                m_queued -= removed_count;
+                client.queued -= removed_count;
+                m_groups[group_idx].queued -= removed_count;
+                if (tasks.empty())
+                    queue.sorted = true;
             }
         }
+
+        // Wake up blocked submitters
+        m_space_cv.notify_all();
+    }
+
+    template <typename Set>
+    void ThreadPool::pause_tasks_impl(const Set &idxs)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        insert_all(m_pause_requested, idxs);
+
+        // Move queued tasks aside, keeping order of the rest (untracked jobs are never paused)
+        for (auto &client : m_clients)
+        {
+            for (size_t group_idx = 0; group_idx < client.queues.size(); group_idx++)
+            {
+                auto &tasks = client.queues[group_idx].tasks;
+                auto out = tasks.begin();
+                for (auto it = tasks.begin(); it != tasks.end(); it++)
+                {
+                    if (it->tracked && idxs.count(it->idx))
+                    {
+                        m_paused.emplace(it->idx, std::move(*it));
+                        continue;
+                    }
+                    if (out != it)
+                        *out = std::move(*it);
+                    out++;
+                }
+                size_t paused_count = tasks.end() - out;
+                m_queued -= paused_count;
+                client.queued -= paused_count;
+                m_groups[group_idx].queued -= paused_count;
+                tasks.erase(out, tasks.end());
+            }
+        }
+    }
+
+    template <typename Set>
+    void ThreadPool::resume_tasks_impl(const Set &idxs)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        erase_all(m_pause_requested, idxs);
+
+        // Collect first, requeue could put the task back into m_paused
+        std::vector<QueueElement> resumed;
+        for (auto it = m_paused.begin(); it != m_paused.end();)
+        {
+            if (!idxs.count(it->first))
+            {
+                it++;
+                continue;
+            }
+            resumed.push_back(std::move(it->second));
+            it = m_paused.erase(it);
+        }
+
+        for (auto &element : resumed)
+        {
+            if (element.started)
+                requeue(std::move(element));
+            else
+                push_ready(std::move(element));
+        }
+    }
+
+    void ThreadPool::remove_tasks(std::unordered_set<size_t> &idxs)
+    {
+        remove_tasks_impl(idxs);
+    }
+
+    void ThreadPool::remove_tasks(SelectionSet &idxs)
+    {
+        remove_tasks_impl(idxs);
+    }
+
+    void ThreadPool::pause_tasks(const std::unordered_set<size_t> &idxs)
+    {
+        pause_tasks_impl(idxs);
+    }
+
+    void ThreadPool::pause_tasks(const SelectionSet &idxs)
+    {
+        pause_tasks_impl(idxs);
+    }
+
+    void ThreadPool::resume_tasks(const std::unordered_set<size_t> &idxs)
+    {
+        resume_tasks_impl(idxs);
+    }
+
+    void ThreadPool::resume_tasks(const SelectionSet &idxs)
+    {
+        resume_tasks_impl(idxs);
+    }
+
+    void ThreadPool::set_limits(const QueueLimits &limits)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        m_limits = limits;
+        m_space_cv.notify_all();
+    }
+
+    void ThreadPool::release_bytes(size_t bytes)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        m_admitted_bytes -= std::min(bytes, m_admitted_bytes);
+        m_space_cv.notify_all();
+    }
+
+    bool ThreadPool::admit(std::unique_lock<std::mutex> &lock, size_t cost)
+    {
+        auto has_space = [this, cost]
+        {
+            bool tasks_ok = m_limits.max_tasks == 0 || m_admitted_tasks < m_limits.max_tasks;
+            // Task larger than the whole budget is admitted alone, otherwise it would never run
+            bool bytes_ok = m_limits.max_bytes == 0 || m_admitted_bytes == 0 ||
+                            m_admitted_bytes + cost <= m_limits.max_bytes;
+            return tasks_ok && bytes_ok;
+        };
+
+        bool admitted = has_space();
+        if (!admitted)
+        {
+            switch (m_limits.policy)
+            {
+            case AdmissionPolicy::Block:
+                m_space_cv.wait(lock, has_space);
+                admitted = true;
+                break;
+            case AdmissionPolicy::TryFor:
+                admitted = m_space_cv.wait_for(lock, m_limits.timeout, has_space);
+                break;
+            case AdmissionPolicy::Reject:
+                break;
+            }
+        }
+
+        if (!admitted)
+        {
+            m_rejected++;
+            return false;
+        }
+
+        m_admitted_tasks++;
+        m_admitted_bytes += cost;
+        return true;
+    }
+
+    void ThreadPool::release_admission(const QueueElement &element, bool release_cost)
+    {
+        // Untracked jobs bypass admission control
+        if (!element.tracked)
+            return;
+
+        if (!element.started)
+            m_admitted_tasks--;
+        if (release_cost)
+            m_admitted_bytes -= std::min(element.cost, m_admitted_bytes);
+
+        // Removed task that has been started already (paused or between time slices)
+        if (release_cost && element.started)
+            m_in_process--;
+
+        // Removed task never finishes, its waiters learn about it from completion queues
+        if (release_cost)
+            report_completion(element);
+    }
+
+    void ThreadPool::set_completion_queue(std::shared_ptr<CompletionQueue> queue)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        m_completion = std::move(queue);
+    }
+
+    void ThreadPool::report_completion(const QueueElement &element)
+    {
+        if (element.completion)
+            element.completion->push(element.idx);
+        if (m_completion)
+            m_completion->push(element.idx);
+    }
+
+    size_t ThreadPool::add_group(const std::string &name, size_t max_running)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        for (size_t i = 1; i < m_groups.size(); i++)
+        {
+            if (m_groups[i].name == name)
+            {
+                m_groups[i].max_running = max_running;
+                m_queue_cv.notify_all();
+                return i;
+            }
+        }
+
+        m_groups.emplace_back(name, max_running);
+        return m_groups.size() - 1;
+    }
+
+    size_t ThreadPool::add_client(const std::string &name, size_t weight)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        for (size_t i = 1; i < m_clients.size(); i++)
+        {
+            if (m_clients[i].name == name)
+            {
+                m_clients[i].weight = std::max<size_t>(weight, 1);
+                return i;
+            }
+        }
+
+        m_clients.emplace_back(name, weight);
+        return m_clients.size() - 1;
+    }
+
+    bool ThreadPool::set_client_weight(size_t client, size_t weight)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        if (client >= m_clients.size())
+            return false;
+
+        m_clients[client].weight = std::max<size_t>(weight, 1);
+        return true;
+    }
+
+    bool ThreadPool::client_stats(size_t client, ClientStats &stats)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        if (client >= m_clients.size())
+            return false;
+
+        stats = m_clients[client].stats;
+        stats.name = m_clients[client].name;
+        stats.weight = m_clients[client].weight;
+        stats.queued = m_clients[client].queued;
+        return true;
+    }
+
+    bool ThreadPool::set_group_limit(size_t group, size_t max_running)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        if (group == 0 || group >= m_groups.size())
+            return false;
+
+        // Raised limit could make queued tasks eligible
+        m_groups[group].max_running = max_running;
+        m_queue_cv.notify_all();
+        return true;
+    }
+
+    void ThreadPool::post(std::function<void()> func, const std::vector<const ITaskInfo *> &deps)
+    {
+        size_t task_idx = m_last_idx++;
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        enqueue(QueueElement(task_idx, std::packaged_task<void()>(std::move(func)), std::promise<void>(), false), deps);
+    }
+
+    uint64_t ThreadPool::add_periodic_task(std::chrono::milliseconds period, std::function<void()> func)
+    {
+        if (period <= std::chrono::milliseconds::zero())
+            return 0;
+
+        auto shared_func = std::make_shared<std::function<void()>>(std::move(func));
+        auto running = std::make_shared<std::atomic<bool>>(false);
+        m_timers.start();
+        return m_timers.schedule(period, period, [this, shared_func, running]
+                                 {
+            // Previous run is still queued or executed
+            if (running->exchange(true))
+                return;
+            post([shared_func, running]
+                 {
+                try
+                {
+                    (*shared_func)();
+                }
+                catch (...)
+                {
+                }
+                *running = false; }); });
+    }
+
+    uint64_t ThreadPool::cancel_if_not_started(size_t idx, std::chrono::milliseconds timeout,
+                                               std::function<void(size_t)> on_cancelled)
+    {
+        m_timers.start();
+        return m_timers.schedule(timeout, std::chrono::milliseconds::zero(), [this, idx, on_cancelled]
+                                 {
+            std::unordered_set<size_t> idxs = {idx};
+            remove_tasks_impl(idxs, true);
+
+            // Not removed indices stay in the set, the callback runs without the queue lock
+            if (idxs.empty() && on_cancelled)
+                on_cancelled(idx); });
+    }
+
+    bool ThreadPool::cancel_timer(uint64_t timer_id)
+    {
+        return m_timers.cancel(timer_id);
+    }
+
+    void ThreadPool::schedule_delayed(QueueElement &&element, std::chrono::milliseconds delay)
+    {
+        // Unknown groups and clients fall back to the default ones
+        if (element.group >= m_groups.size())
+            element.group = 0;
+        if (element.client >= m_clients.size())
+            element.client = 0;
+
+        // The action waits for m_queue_mtx, so the task is registered before it could be released
+        size_t idx = element.idx;
+        m_timers.start();
+        uint64_t timer_id = m_timers.schedule(delay, std::chrono::milliseconds::zero(), [this, idx]
+                                              { release_delayed(idx); });
+        m_delayed.emplace(idx, DelayedElement{std::move(element), timer_id});
+    }
+
+    void ThreadPool::release_delayed(size_t idx)
+    {
+        std::lock_guard<std::mutex> q_lock(m_queue_mtx);
+        auto it = m_delayed.find(idx);
+        if (it == m_delayed.end())
+            return;
+
+        push_ready(std::move(it->second.element));
+        m_delayed.erase(it);
+    }
+
+    void ThreadPool::enqueue(QueueElement &&element, const std::vector<const ITaskInfo *> &deps)
+    {
+        // Unknown groups and clients fall back to the default ones
+        if (element.group >= m_groups.size())
+            element.group = 0;
+        if (element.client >= m_clients.size())
+            element.client = 0;
+
+        // Collect unfinished dependencies
+        // Workers release dependents under m_queue_mtx after the result is set,
+        // so a dependency that is not completed here is guaranteed to release this task later.
+        // Rejected dependencies never run and would keep the task waiting forever, they are skipped
+        std::vector<size_t> unfinished;
+        for (const ITaskInfo *dep : deps)
+        {
+            if (dep && dep->valid() && dep->status() != TaskStatus::Completed)
+                unfinished.push_back(dep->id());
+        }
+
+        if (unfinished.empty())
+        {
+            push_ready(std::move(element));
+            return;
+        }
+
+        // Register task in dependency graph
+        size_t idx = element.idx;
+        for (size_t dep : unfinished)
+        {
+            m_dependents[dep].push_back(idx);
+        }
+        size_t remaining = unfinished.size();
+        m_waiting.emplace(idx, WaitingElement{std::move(element), std::move(unfinished), remaining});
+    }
+
+    void ThreadPool::push_ready(QueueElement &&element)
+    {
+        // Task was paused before it became ready
+        if (element.tracked && m_pause_requested.count(element.idx))
+        {
+            m_paused.emplace(element.idx, std::move(element));
+            return;
+        }
+
+        // Time in the queue is counted till the task starts (see ClientStats)
+        element.queued_at = std::chrono::steady_clock::now();
+        size_t client = element.client;
+        size_t group = element.group;
+
+        // Released dependents are older than tasks at the back, keep queue sorted for remove_tasks
+        TaskQueue &queue = queue_of(element);
+        auto &tasks = queue.tasks;
+        if (!queue.sorted || tasks.empty() || tasks.back().idx < element.idx)
+        {
+            tasks.push_back(std::move(element));
+        }
         else
         {
-            // Remove using remove&erase idiom
-            m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(),
-                                         [&idxs](const QueueElement &task)
-                                         {
-                                             bool to_delete = idxs.count(task.idx);
-                                             if (to_delete)
-                                             {
-                                                 idxs.erase(task.idx);
-                                             }
-                                             return to_delete;
-                                         }),
-                          m_tasks.end());
+            auto it = std::upper_bound(tasks.begin(), tasks.end(), element.idx,
+                                       [](size_t target_idx, const QueueElement &task)
+                                       { return target_idx < task.idx; });
+            tasks.insert(it, std::move(element));
+        }
+        m_queued++;
+        m_clients[client].queued++;
+        m_groups[group].queued++;
+
+        // Spinning workers will pick the task up without a wakeup
+        if (m_spinning < m_queued)
+            m_queue_cv.notify_one();
+    }
+
+    void ThreadPool::requeue(QueueElement &&element)
+    {
+        if (element.tracked && m_pause_requested.count(element.idx))
+        {
+            m_paused.emplace(element.idx, std::move(element));
+            return;
+        }
+
+        size_t client = element.client;
+        size_t group = element.group;
+        TaskQueue &queue = queue_of(element);
+        if (!queue.tasks.empty() && queue.tasks.back().idx > element.idx)
+            queue.sorted = false;
+        queue.tasks.push_back(std::move(element));
+        m_queued++;
+        m_clients[client].queued++;
+        m_groups[group].queued++;
+
+        if (m_spinning < m_queued)
+            m_queue_cv.notify_one();
+    }
+
+    void ThreadPool::release_dependents(size_t idx)
+    {
+        auto it = m_dependents.find(idx);
+        if (it == m_dependents.end())
+            return;
+
+        for (size_t dependent : it->second)
+        {
+            auto waiting_it = m_waiting.find(dependent);
+            if (waiting_it == m_waiting.end() || --waiting_it->second.remaining != 0)
+                continue;
+
+            push_ready(std::move(waiting_it->second.element));
+            m_waiting.erase(waiting_it);
         }
+        m_dependents.erase(it);
+    }
+
+    ThreadPool::TaskQueue &ThreadPool::queue_of(const QueueElement &element)
+    {
+        // Queues of a client are created for groups added after the client
+        auto &queues = m_clients[element.client].queues;
+        if (queues.size() <= element.group)
+            queues.resize(m_groups.size());
+        return queues[element.group];
+    }
+
+    bool ThreadPool::next_task(size_t &client, size_t &group) const
+    {
+        for (size_t i = 0; i < m_clients.size(); i++)
+        {
+            size_t candidate = (m_next_client + i) % m_clients.size();
+            if (next_group(m_clients[candidate], group))
+            {
+                client = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ThreadPool::next_group(const Client &client, size_t &group) const
+    {
+        if (client.queued == 0)
+            return false;
+
+        for (size_t i = 0; i < client.queues.size(); i++)
+        {
+            size_t candidate = (client.next_group + i) % client.queues.size();
+            const Group &g = m_groups[candidate];
+            if (!client.queues[candidate].tasks.empty() && (g.max_running == 0 || g.running < g.max_running))
+            {
+                group = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::finish_running(const QueueElement &element)
+    {
+        Group &group = m_groups[element.group];
+        group.running--;
+
+        // Other workers could be parked while the group has been at the limit
+        if (group.max_running != 0 && group.queued != 0)
+            m_queue_cv.notify_one();
+    }
+
+    void ThreadPool::spin_wait()
+    {
+        const size_t spin_count = m_options.idle.spin_count;
+        const size_t total = spin_count + m_options.idle.yield_count;
+        if (total == 0)
+            return;
+
+        m_spinning++;
+        for (size_t i = 0; i < total && m_queued == 0 && m_active; i++)
+        {
+            if (i < spin_count)
+                cpu_relax();
+            else
+                std::this_thread::yield();
+        }
+        m_spinning--;
+    }
+
+    size_t ThreadPool::current_task_id()
+    {
+        return t_current_task;
     }
 
     void ThreadPool::run()
     {
         while (m_active)
         {
+            t_current_task = kNoTask;
+
+            // Try to catch new tasks before parking
+            if (m_queued == 0)
+                spin_wait();
+
             std::unique_lock<std::mutex> lock(m_queue_mtx);
-            m_queue_cv.wait(lock, [this]
-                            { return !m_tasks.empty() || !m_active; });
+            size_t client_idx = 0;
+            size_t group_idx = 0;
+            bool found = false;
+            m_queue_cv.wait(lock, [this, &client_idx, &group_idx, &found]
+                            { return (found = next_task(client_idx, group_idx)) || !m_active; });
 
-            if (!m_tasks.empty())
+            if (found)
             {
-                // Get task
-                auto task = std::move(m_tasks.front());
-                m_tasks.pop_front();
+                // Weighted deficit round robin: a client is served weight times in a row
+                // Skipped clients (empty or blocked by group limits) lose the rest of their turn
+                Client &client = m_clients[client_idx];
+                for (size_t c = m_next_client; c != client_idx; c = (c + 1) % m_clients.size())
+                {
+                    m_clients[c].deficit = 0;
+                }
+                if (client.deficit == 0)
+                    client.deficit = client.weight;
+                m_next_client = (--client.deficit == 0) ? (client_idx + 1) % m_clients.size() : client_idx;
+
+                // Get task, the next task of the client is taken from the next group
+                Group &group = m_groups[group_idx];
+                TaskQueue &queue = client.queues[group_idx];
+                auto task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                m_queued--;
+                client.queued--;
+                group.queued--;
+                if (queue.tasks.empty())
+                    queue.sorted = true;
+                client.next_group = (group_idx + 1) % client.queues.size();
+
+                // Untracked jobs are not limited by groups
+                if (task.tracked)
+                    group.running++;
+
+                // Started task frees its slot in the queue
+                if (task.tracked && !task.started)
+                {
+                    m_in_process++;
+                    release_admission(task, false);
+                    m_space_cv.notify_all();
+
+                    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - task.queued_at);
+                    client.stats.started++;
+                    client.stats.total_wait += wait;
+                    client.stats.max_wait = std::max(client.stats.max_wait, wait);
+                }
 
                 // Unlock the queue
                 lock.unlock();
+                t_current_task = task.idx;
+
+                // Untracked jobs (see post) are just executed
+                if (!task.tracked)
+                {
+                    task.task();
+                    continue;
+                }
 
-                // Send event (task in progress)
-                mEvent.call(task.idx, false);
+                if (!task.started)
+                {
+                    // Send event (task in progress)
+                    mEvent.call(task.idx, false);
 
-                // Indicate that computations stated
-                task.start_promise.set_value();
+                    // Indicate that computations stated
+                    task.start_promise.set_value();
+                    task.started = true;
+                }
 
                 // Start actual computations
-                task.task();
+                if (task.step)
+                {
+                    // Resumable task runs for one time slice
+                    if (!task.step(std::chrono::steady_clock::now() + m_options.time_slice))
+                    {
+                        lock.lock();
+                        finish_running(task);
+                        requeue(std::move(task));
+                        continue;
+                    }
+                }
+                else
+                {
+                    task.task();
+                }
 
                 // Update number of finished tasks
+                m_in_process--;
                 m_finished++;
 
+                // Queue tasks that were waiting for this one
+                lock.lock();
+                finish_running(task);
+                m_pause_requested.erase(task.idx);
+                release_dependents(task.idx);
+                report_completion(task);
+                m_clients[task.client].stats.finished++;
+                lock.unlock();
+
                 // Send event (task finished)
                 mEvent.call(task.idx, true);
             }
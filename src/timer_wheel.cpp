@@ -0,0 +1,235 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace TP
+{
+    TimerWheel::TimerWheel(Clock::duration resolution) : m_resolution(resolution), m_origin(Clock::now())
+    {
+    }
+
+    TimerWheel::~TimerWheel()
+    {
+        stop();
+    }
+
+    bool TimerWheel::start()
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_active)
+            return false;
+
+        m_active = true;
+        if (m_timers.empty())
+            m_tick = now();
+        m_thread = std::thread(&TimerWheel::run, this);
+        return true;
+    }
+
+    bool TimerWheel::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (!m_active)
+                return false;
+            m_active = false;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+
+        // Drop pending timers
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for (auto &level : m_slots)
+        {
+            for (auto &s : level)
+            {
+                s.head = nullptr;
+            }
+        }
+        m_timers.clear();
+        m_wakeup = UINT64_MAX;
+        return true;
+    }
+
+    uint64_t TimerWheel::schedule(Clock::duration delay, Clock::duration period, std::function<void()> action)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        // Nothing to cascade, skip ticks passed while the wheel was empty
+        if (m_timers.empty())
+            m_tick = now();
+
+        uint64_t id = ++m_last_id;
+        Timer &timer = m_timers[id];
+        timer.id = id;
+
+        // Round up, so the action is never called earlier than requested
+        auto expires = Clock::now() - m_origin + std::max(delay, Clock::duration::zero());
+        timer.expires = (expires + m_resolution - Clock::duration(1)) / m_resolution;
+        timer.period = (period > Clock::duration::zero()) ? std::max<uint64_t>((period + m_resolution - Clock::duration(1)) / m_resolution, 1) : 0;
+        timer.action = std::move(action);
+        link(&timer);
+
+        // Wake up the thread if the timer is due before it wakes up anyway
+        if (timer.expires < m_wakeup)
+            m_cv.notify_one();
+        return id;
+    }
+
+    bool TimerWheel::cancel(uint64_t timer_id)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        auto it = m_timers.find(timer_id);
+        if (it == m_timers.end())
+            return false;
+
+        unlink(&it->second);
+        m_timers.erase(it);
+        return true;
+    }
+
+    size_t TimerWheel::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_timers.size();
+    }
+
+    void TimerWheel::link(Timer *timer)
+    {
+        // Past timers are called at the next processed tick
+        uint64_t expires = std::max(timer->expires, m_tick);
+        if (expires - m_tick > kMaxDelay)
+        {
+            expires = m_tick + kMaxDelay;
+            timer->expires = expires;
+        }
+
+        // The lowest level that covers the delay
+        uint64_t delta = expires - m_tick;
+        Slot *s = &m_slots[0][expires & (kLevel0Size - 1)];
+        for (int level = 1; level < kNumLevels && delta >= (uint64_t(1) << (kLevel0Bits + (level - 1) * kLevelBits)); level++)
+        {
+            s = &m_slots[level][(expires >> (kLevel0Bits + (level - 1) * kLevelBits)) & (kLevelSize - 1)];
+        }
+
+        timer->slot = s;
+        timer->prev = nullptr;
+        timer->next = s->head;
+        if (s->head)
+            s->head->prev = timer;
+        s->head = timer;
+    }
+
+    void TimerWheel::unlink(Timer *timer)
+    {
+        if (timer->next)
+            timer->next->prev = timer->prev;
+        if (timer->prev)
+            timer->prev->next = timer->next;
+        else
+            timer->slot->head = timer->next;
+    }
+
+    uint64_t TimerWheel::cascade(int level)
+    {
+        uint64_t idx = (m_tick >> (kLevel0Bits + (level - 1) * kLevelBits)) & (kLevelSize - 1);
+        Timer *timer = m_slots[level][idx].head;
+        m_slots[level][idx].head = nullptr;
+        while (timer)
+        {
+            Timer *next = timer->next;
+            link(timer);
+            timer = next;
+        }
+        return idx;
+    }
+
+    uint64_t TimerWheel::next_wakeup() const
+    {
+        if (m_timers.empty())
+            return UINT64_MAX;
+
+        // Scan level 0 till it wraps, timers of higher levels are cascaded there
+        for (uint64_t tick = m_tick;; tick++)
+        {
+            if (m_slots[0][tick & (kLevel0Size - 1)].head)
+                return tick;
+            if (((tick + 1) & (kLevel0Size - 1)) == 0)
+                return tick + 1;
+        }
+    }
+
+    uint64_t TimerWheel::now() const
+    {
+        return (Clock::now() - m_origin) / m_resolution;
+    }
+
+    void TimerWheel::run()
+    {
+        std::vector<std::function<void()>> due;
+
+        std::unique_lock<std::mutex> lock(m_mtx);
+        while (m_active)
+        {
+            // Process all ticks till now
+            uint64_t target = now();
+            while (m_tick <= target && !m_timers.empty())
+            {
+                uint64_t idx = m_tick & (kLevel0Size - 1);
+                if (idx == 0)
+                {
+                    // Lower level wrapped, move timers of the next slot of every level down
+                    for (int level = 1; level < kNumLevels && cascade(level) == 0; level++)
+                    {
+                    }
+                }
+
+                Timer *timer = m_slots[0][idx].head;
+                m_slots[0][idx].head = nullptr;
+                while (timer)
+                {
+                    Timer *next = timer->next;
+                    if (timer->period)
+                    {
+                        // Missed periods are skipped
+                        timer->expires += timer->period;
+                        if (timer->expires <= m_tick)
+                            timer->expires = m_tick + 1;
+                        due.push_back(timer->action);
+                        link(timer);
+                    }
+                    else
+                    {
+                        due.push_back(std::move(timer->action));
+                        m_timers.erase(timer->id);
+                    }
+                    timer = next;
+                }
+                m_tick++;
+            }
+            if (m_timers.empty())
+                m_tick = target + 1;
+
+            // Call actions without the lock, they could schedule new timers
+            if (!due.empty())
+            {
+                lock.unlock();
+                for (auto &action : due)
+                {
+                    action();
+                }
+                due.clear();
+                lock.lock();
+                continue;
+            }
+
+            m_wakeup = next_wakeup();
+            if (m_wakeup == UINT64_MAX)
+                m_cv.wait(lock);
+            else
+                m_cv.wait_until(lock, m_origin + m_resolution * m_wakeup);
+            m_wakeup = UINT64_MAX;
+        }
+    }
+}
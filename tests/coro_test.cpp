@@ -0,0 +1,146 @@
+#include "coro.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    int g_failures = 0;
+
+    /**
+     * @brief Reports failed condition
+     */
+    void check(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    TP::Task<std::thread::id> worker_id(TP::ThreadPool &pool)
+    {
+        co_await pool.schedule();
+        co_return std::this_thread::get_id();
+    }
+
+    TP::Task<int> square(TP::ThreadPool &pool, int value)
+    {
+        co_await pool.schedule();
+        if (value < 0)
+            throw std::invalid_argument("negative");
+        co_return value * value;
+    }
+
+    TP::Task<int> sleepy(TP::ThreadPool &pool, int ms)
+    {
+        co_await pool.schedule();
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        co_return ms;
+    }
+
+    TP::Task<int> await_task(TP::ThreadPool &pool, const TP::TaskInfo<int> &info)
+    {
+        co_return co_await TP::completion(pool, info) + 1;
+    }
+
+    TP::Task<int> sum_of_squares(TP::ThreadPool &pool, std::vector<int> values)
+    {
+        std::vector<TP::Task<int>> tasks;
+        for (int value : values)
+        {
+            tasks.push_back(square(pool, value));
+        }
+        int sum = 0;
+        for (int result : co_await TP::when_all(std::move(tasks)))
+        {
+            sum += result;
+        }
+        co_return sum;
+    }
+
+    TP::Task<std::pair<size_t, int>> first_of(TP::ThreadPool &pool)
+    {
+        std::vector<TP::Task<int>> tasks;
+        tasks.push_back(sleepy(pool, 500));
+        tasks.push_back(sleepy(pool, 1));
+        co_return co_await TP::when_any(std::move(tasks));
+    }
+
+    void test_schedule(TP::ThreadPool &pool)
+    {
+        check(TP::sync_wait(worker_id(pool)) != std::this_thread::get_id(), "schedule does not move to a worker");
+    }
+
+    void test_completion(TP::ThreadPool &pool)
+    {
+        auto info = pool.add_task([]
+                                  {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            return 41; });
+        check(TP::sync_wait(await_task(pool, info)) == 42, "completion result");
+    }
+
+    void test_when_all(TP::ThreadPool &pool)
+    {
+        check(TP::sync_wait(sum_of_squares(pool, {1, 2, 3, 4})) == 30, "when_all results");
+
+        // Several failing tasks race to publish their exception
+        bool thrown = false;
+        try
+        {
+            TP::sync_wait(sum_of_squares(pool, {1, -2, 3, -4, -5}));
+        }
+        catch (const std::invalid_argument &)
+        {
+            thrown = true;
+        }
+        check(thrown, "when_all exception");
+    }
+
+    void test_when_any(TP::ThreadPool &pool)
+    {
+        auto first = TP::sync_wait(first_of(pool));
+        check(first.first == 1 && first.second == 1, "when_any first finished task");
+    }
+
+    /**
+     * @brief Removing the whole id range does not drop a suspended coroutine
+     */
+    void test_remove_all_while_suspended(TP::ThreadPool &pool)
+    {
+        auto info = pool.add_task([]
+                                  {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return 1; });
+        auto waiter = std::async(std::launch::async, [&pool, &info]
+                                 { return TP::sync_wait(await_task(pool, info)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        TP::SelectionSet all;
+        all.insert_range(0, 100000);
+        pool.remove_tasks(all);
+        check(waiter.wait_for(std::chrono::seconds(5)) == std::future_status::ready && waiter.get() == 2,
+              "coroutine removed with its task id range");
+    }
+}
+
+int main()
+{
+    TP::ThreadPool pool;
+    pool.start(4);
+
+    test_schedule(pool);
+    test_completion(pool);
+    test_when_all(pool);
+    test_when_any(pool);
+    test_remove_all_while_suspended(pool);
+
+    if (g_failures)
+        return 1;
+    std::printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+
+namespace
+{
+    const std::chrono::seconds kTimeout(5);
+
+    int g_failures = 0;
+
+    /**
+     * @brief Reports failed condition
+     */
+    void check(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            g_failures++;
+        }
+    }
+
+    /**
+     * @brief Selection of all ids issued by the pool so far (e.g. select all in the GUI)
+     */
+    TP::SelectionSet select_all()
+    {
+        TP::SelectionSet all;
+        all.insert_range(0, 1000);
+        return all;
+    }
+
+    /**
+     * @brief Removing the whole id range keeps untracked jobs queued
+     */
+    void test_remove_keeps_posted_jobs()
+    {
+        TP::ThreadPool pool;
+        auto before = pool.add_task([]
+                                    { return 1; });
+        std::promise<void> posted;
+        pool.post([&posted]
+                  { posted.set_value(); });
+        auto after = pool.add_task([]
+                                   { return 2; });
+
+        TP::SelectionSet all = select_all();
+        pool.remove_tasks(all);
+        pool.start(2);
+
+        check(posted.get_future().wait_for(kTimeout) == std::future_status::ready, "removed posted job");
+        check(before.status() == TP::TaskStatus::Completed, "task before posted job is not removed");
+        check(after.status() == TP::TaskStatus::Completed, "task after posted job is not removed");
+        bool broken = false;
+        try
+        {
+            after.result();
+        }
+        catch (const std::future_error &)
+        {
+            broken = true;
+        }
+        check(broken, "removed task has a result");
+    }
+
+    /**
+     * @brief Pausing the whole id range keeps untracked jobs queued
+     */
+    void test_pause_keeps_posted_jobs()
+    {
+        TP::ThreadPool pool;
+        auto task = pool.add_task([]
+                                  { return 1; });
+        std::promise<void> posted;
+        pool.post([&posted]
+                  { posted.set_value(); });
+
+        TP::SelectionSet all = select_all();
+        pool.pause_tasks(all);
+        pool.start(2);
+
+        check(posted.get_future().wait_for(kTimeout) == std::future_status::ready, "paused posted job");
+        check(task.status() == TP::TaskStatus::InQueue, "paused task is started");
+
+        pool.resume_tasks(all);
+        check(task.future().wait_for(kTimeout) == std::future_status::ready && task.result() == 1,
+              "resumed task is not finished");
+    }
+
+    /**
+     * @brief Task that has not started in time is removed and reported to its owner
+     */
+    void test_cancel_if_not_started()
+    {
+        TP::ThreadPool pool;
+        auto task = pool.add_task([]
+                                  { return 1; });
+        std::promise<size_t> cancelled;
+        pool.cancel_if_not_started(task.id(), std::chrono::milliseconds(10), [&cancelled](size_t idx)
+                                   { cancelled.set_value(idx); });
+
+        auto cancelled_idx = cancelled.get_future();
+        check(cancelled_idx.wait_for(kTimeout) == std::future_status::ready && cancelled_idx.get() == task.id(),
+              "cancelled task is not reported");
+        check(task.status() == TP::TaskStatus::Completed, "cancelled task is still queued");
+        check(pool.num_timers() == 0, "timer of the cancelled task is still active");
+    }
+}
+
+int main()
+{
+    test_remove_keeps_posted_jobs();
+    test_pause_keeps_posted_jobs();
+    test_cancel_if_not_started();
+
+    if (g_failures)
+        return 1;
+    std::printf("All tests passed\n");
+    return 0;
+}